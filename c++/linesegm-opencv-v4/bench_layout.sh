@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Compare the row-major and tiled search rasters on the given pages.
+# Usage: ./bench_layout.sh data/wide/*.jpg [-s 1 -mf 5]
+# Reports wall time and, when perf is installed, cache and LLC misses.
+
+if [ $# -eq 0 ]; then
+    echo "Usage: ./bench_layout.sh [FILES]... [OPTIONS]..."
+    exit 1
+fi
+
+EVENTS="cache-references,cache-misses,L1-dcache-load-misses,LLC-load-misses"
+
+for layout in rowmajor tiled
+do
+    echo "## Layout: $layout"
+    if command -v perf > /dev/null; then
+        perf stat -e $EVENTS ./bin/linesegm "$@" --layout $layout 2>&1 > /dev/null | grep -E "cache|LLC|elapsed"
+    else
+        /usr/bin/time -f "%e s elapsed, %M KB max resident" ./bin/linesegm "$@" --layout $layout > /dev/null
+    fi
+    echo " "
+done
@@ -0,0 +1,86 @@
+/*
+ * gtraster.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+
+#include "opencv2/opencv.hpp"
+#include <chrono>
+#include <iostream>
+#include "src/utils.cpp"
+#include "src/rasterize.cpp"
+
+using namespace std;
+using namespace cv;
+
+
+inline void print_usage () {
+
+	fprintf(stderr,
+	            "Usage: bin/gtraster XML_FOLDER IMAGES_FOLDER OUT_FOLDER [OPTIONS]...\n"
+	            "Rasterizes the text lines of PAGE-XML files into the groundtruth stores (.gtl)\n"
+	            "read by bin/linesegm --stats, one <page>.gtl per image in OUT_FOLDER.\n"
+	            "\n"
+	            "Options:\n"
+	            "\t--scale number\t\tRasterize at this fraction of the image resolution (default 1) into\n"
+	            "             \t\t\t<page>@<scale>.gtl, read by bin/linesegm --stats --scale number.\n"
+	            "\t--binarized  \t\tThe images are black and white already: skip Sauvola.\n"
+	            "\t-j integer   \t\tRasterize this many pages in parallel.\n"
+	            "\t--perf       \t\tShow the hardware counters of the binarization of every page.\n"
+	            "\t--help       \t\tShow this help information.\n"
+	            "\n"
+	            "Examples:\n"
+	            "\tbin/gtraster data/saintgall/groundtruth/xml/ data/saintgall/images/ data/saintgall/groundtruth/ -j 8\n");
+
+	    exit(0);
+
+}
+
+int main (int argc, char* argv[]) {
+
+	if (argc < 4) {
+		print_usage();
+	}
+
+	RasterOptions options;
+	for (int i = 1; i < argc; i++) {
+
+		if (!strcmp(argv[i], "--help")) {
+			print_usage();
+		}
+
+		if (!strcmp(argv[i], "--scale") and i + 1 < argc) {
+			options.scale = atof(argv[i + 1]);
+			if (options.scale <= 0 or options.scale > 1) options.scale = 1;
+		}
+
+		if (!strcmp(argv[i], "--perf")) {
+			perf_enabled() = true;
+		}
+
+		if (!strcmp(argv[i], "--binarized")) {
+			options.binarized = true;
+		}
+
+		if (!strcmp(argv[i], "-j") and i + 1 < argc) {
+			options.jobs = max(atoi(argv[i + 1]), 1);
+		}
+	}
+
+	string xml_folder = argv[1], images_folder = argv[2], out_folder = argv[3];
+	for (string* folder : {&xml_folder, &images_folder, &out_folder}) {
+		if (folder->empty() or (*folder)[folder->size() - 1] != '/') {
+			*folder += "/";
+		}
+	}
+	ensure_directory_exists(out_folder);
+
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	cout << "- Rasterizing " << xml_folder << " at scale " << options.scale << ".." << endl;
+	int pages = rasterize_groundtruth(xml_folder, images_folder, out_folder, options);
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout << "\n- " << pages << " pages written in " << elapsed << " s" << endl;
+
+	return 0;
+}
@@ -13,6 +13,18 @@
 #include "src/sauvola.cpp"
 #include "src/linelocalization.cpp"
 #include "src/astar.cpp"
+#include "src/textarea.cpp"
+#include "src/pipeline.cpp"
+#include "src/deskew.cpp"
+#include "src/evaluation.cpp"
+#include "src/batch.cpp"
+#include "src/sweep.cpp"
+#include "src/profile.cpp"
+#include "src/tuner.cpp"
+#include "src/localizationstats.cpp"
+#include "src/linecrops.cpp"
+#include "src/container.cpp"
+#include "src/incremental.cpp"
 
 using namespace std;
 using namespace cv;
@@ -21,10 +33,11 @@ using namespace cv;
 int main (int argc, char* argv[]) {
 
 	clock_t begin = clock();
+	install_memory_tracking();
 
 	vector<string> filenames;
 	for (int i = 1; i < argc; i++) {
-		if (strcmp(argv[i], "--stats") == 0 or strcmp(argv[i], "-s") == 0 or strcmp(argv[i], "-mf") == 0) {
+		if (argv[i][0] == '-') {
 			break;
 		} else {
 			filenames.push_back(argv[i]);
@@ -33,8 +46,32 @@ int main (int argc, char* argv[]) {
 
 	// parameters parsing
 	bool flag_stats = false;
-	int step = 2;
-	int mfactor = 5;
+	bool tight_crops = false;
+	string container_path;
+	string io_backend = "uring";
+	PageOptions page;
+	bool adaptive_step = false;
+	int adaptive_clearance = 4;
+	int jobs = 1;
+	string sweep_grid;
+	string tune_name;
+	double target_hitrate = 0.9;
+	int sample = 0;
+	bool localize_only = false;
+	vector<double> spreads{0.66};
+	vector<SearchEdit> corrections;
+	SearchOptions options;
+
+	// A profile comes first, so that the options given with it override its values.
+	for (int i = 1; i < argc - 1; i++) {
+		if (!strcmp(argv[i], "--profile")) {
+			Profile profile;
+			if (!load_profile(argv[i + 1], profile)) {
+				return 1;
+			}
+			apply_profile(profile, options);
+		}
+	}
 
 	for (int i = 1; i < argc; i++) {
 
@@ -46,101 +83,275 @@ int main (int argc, char* argv[]) {
 			flag_stats = true;
 		}
 
-		if (!strcmp(argv[i], "-s")) {
-			step = atoi(argv[i + 1]);
-			if (step > 2) step = 2;
-			else if (step < 1) step = 1;
+		if (!strcmp(argv[i], "--tight-crops")) {
+			tight_crops = true;
+		}
+
+		if (!strcmp(argv[i], "--container")) {
+			container_path = argv[i + 1];
+		}
+
+		if (!strcmp(argv[i], "--io")) {
+			io_backend = argv[i + 1];
+		}
+
+		if (!strcmp(argv[i], "--crop")) {
+			page.crop = true;
+		}
+
+		if (!strcmp(argv[i], "--columns")) {
+			page.columns = true;
+		}
+
+		if (!strcmp(argv[i], "--scale")) {
+			page.scale = atof(argv[i + 1]);
+			if (page.scale <= 0 or page.scale > 1) page.scale = 1;
+		}
+
+		if (!strcmp(argv[i], "--deskew")) {
+			page.deskew = true;
+		}
+
+		if (!strcmp(argv[i], "-s") and !strcmp(argv[i + 1], "auto")) {
+			adaptive_step = true;
+			options.step = 1;
+		} else if (!strcmp(argv[i], "-s")) {
+			options.step = atoi(argv[i + 1]);
+			if (options.step > 2) options.step = 2;
+			else if (options.step < 1) options.step = 1;
 		}
 
 		if (!strcmp(argv[i], "-mf")) {
-			mfactor = atoi(argv[i + 1]);
+			options.mfactor = atoi(argv[i + 1]);
+		}
+
+		if (!strcmp(argv[i], "--layout")) {
+			if (!parse_layout(argv[i + 1], options.layout)) {
+				cout << "ERROR! unknown layout '" << argv[i + 1] << "', use rowmajor or tiled" << endl;
+				return 1;
+			}
+		}
+
+		if (!strcmp(argv[i], "-ac")) {
+			adaptive_clearance = max(atoi(argv[i + 1]), 1);
+		}
+
+		if (!strcmp(argv[i], "--solver")) {
+			options.solver = argv[i + 1];
+		}
+
+		if (!strcmp(argv[i], "--parallel-search")) {
+			options.search_threads = max(atoi(argv[i + 1]), 1);
+		}
+
+		if (!strcmp(argv[i], "-j")) {
+			jobs = max(atoi(argv[i + 1]), 1);
+		}
+
+		if (!strcmp(argv[i], "--skip-blank")) {
+			options.skip_clearance = max(atoi(argv[i + 1]), 1);
+		}
+
+		if (!strcmp(argv[i], "-cw")) {
+			options.corridor = max(atoi(argv[i + 1]), 0);
+		}
+
+		if (!strcmp(argv[i], "--perf")) {
+			perf_enabled() = true;
+		}
+
+		if (!strcmp(argv[i], "--mem-budget")) {
+			options.memory_budget = (size_t) (max(atof(argv[i + 1]), 0.0) * 1024 * 1024);
+		}
+
+		if (!strcmp(argv[i], "--localize-only")) {
+			localize_only = true;
+		}
+
+		if (!strcmp(argv[i], "--spread")) {
+			spreads.clear();
+			stringstream list(argv[i + 1]);
+			string value;
+			while (getline(list, value, ',')) {
+				spreads.push_back(atof(value.c_str()));
+			}
+			options.spread = spreads.empty() ? 0.66 : spreads[0];
+		}
+
+		if (!strcmp(argv[i], "--corrections") and !load_corrections(argv[i + 1], corrections)) {
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "--sweep")) {
+			sweep_grid = argv[i + 1];
+		}
+
+		if (!strcmp(argv[i], "--tune")) {
+			tune_name = argv[i + 1];
+		}
+
+		if (!strcmp(argv[i], "--target-hitrate")) {
+			target_hitrate = atof(argv[i + 1]);
+		}
+
+		if (!strcmp(argv[i], "--sample")) {
+			sample = max(atoi(argv[i + 1]), 0);
 		}
 	}
 
+	if (adaptive_step) {
+		options.adaptive_clearance = adaptive_clearance;
+	}
+
 	cout << "\n########################################" << endl;
 	cout << "##          LINE SEGMENTATION         ##" << endl;
 	cout << "########################################" << endl;
 
 	ensure_directory_exists("data/");
 
-	for (string filename : filenames) {
+	// The groundtruth is in the frame of the original page, the paths of a deskewed page are not.
+	if (page.deskew and (flag_stats or localize_only or !tune_name.empty() or !sweep_grid.empty())) {
+		cout << "\tERROR! --deskew cannot be used with --stats, --localize-only, --tune or --sweep" << endl;
+		return 1;
+	}
+
+	// With --localize-only the lines are only localized and counted, once per --spread value.
+	if (localize_only) {
+		evaluate_localization(filenames, page, spreads, jobs);
+		filenames.clear();
+	}
+
+	// With --tune the pages are only used to pick the parameters of a profile.
+	if (!tune_name.empty()) {
+		Profile profile = tune_profile(filenames, page, options, tune_name, target_hitrate, sample, jobs);
+		if (save_profile(profile)) {
+			cout << "\n- Profile saved to " << profile_path(tune_name) << endl;
+		}
+		filenames.clear();
+	}
+
+	// With --sweep the pages are only evaluated, once per configuration of the grid.
+	if (!sweep_grid.empty()) {
+		run_sweep(filenames, page, options, sweep_grid, jobs);
+		filenames.clear();
+	}
+
+	// With --stats and -j the pages are only segmented and evaluated, several at a time.
+	if (flag_stats and jobs > 1) {
+		evaluate_dataset(filenames, page, options, jobs);
+		filenames.clear();
+	}
+
+	// With --container the lines and paths of all the pages go to one file instead of data/line_<n>.jpg.
+	BatchWriter container;
+	if (!container_path.empty() and !filenames.empty() and !container.open(container_path)) {
+		cout << "\tERROR! could not open the container " << container_path << endl;
+		return 1;
+	}
+
+	// Pages are read one ahead and the outputs written in the background.
+	AsyncIo io(64, 4, io_backend != "threads");
+	shared_ptr<IoRequest> next_input;
+	if (!filenames.empty()) {
+		cout << "- File I/O: " << io.backend() << endl;
+		next_input = io.read(filenames[0]);
+	}
+
+	for (unsigned int f = 0; f < filenames.size(); f++) {
+
+		string filename = filenames[f];
+		shared_ptr<IoRequest> input = next_input;
+		if (f + 1 < filenames.size()) {
+			next_input = io.read(filenames[f + 1]);
+		}
 
 		cout << "\n===============================================================" << endl;
 		cout << "Reading image '" << filename << "'" << endl;
 
 		clock_t begin_for = clock();
+		StageMeter page_meter;
 
-		string dataset_name = infer_dataset(filename);
-		cout << "Database " << dataset_name << endl;
+		select_dataset(options, filename);
+		cout << "Database " << options.dataset << endl;
 
-		Mat imbw = imread(filename, 0);
+		Mat imbw;
+		if (io.wait(input) and !input->data.empty()) {
+			imbw = imdecode(Mat(1, (int) input->data.size(), CV_8U, input->data.data()), 0);
+		}
+		if (imbw.empty()) {
+			imbw = imread(filename, 0);
+		}
+		input.reset();
 		//Mat imbw (im.rows, im.cols, CV_8U);
 
 		cout << "- Thresholding.." << endl;
 		//binarize(im, imbw, 20, 128, 0.4);
-		Mat bw = imbw.clone();
 		//Mat element = getStructuringElement( MORPH_RECT, Size(5, 5), Point(2, 2));
 		//morphologyEx(imbw, imbw, 2, element );
-		imwrite("data/bw.jpg", bw);
-
-		cout << "- Detecting lines location..";
-		vector<int> lines = localize(imbw);
-		cout << " ==> " << lines.size() + 1 << " lines found." << endl;
 
-		cout << "- A* path planning algorithm.." << endl;
-		Map map;
-		map.grid = imbw / 255;
-		map.dmat = distance_transform(map.grid);
+		vector<RegionPaths> regions = corrections.empty() ? segment_page(imbw, page, options, cout)
+														  : correct_page(imbw, page, options, corrections, cout);
+		Mat bw = imbw.clone();
+		save_image("data/bw.jpg", bw, &io);
 
-		typedef Map::Node Node;
-		vector<vector<Node>> paths;
-		Mat image_path = map.grid.clone();
-		Mat image_path_original = map.grid.clone();
+		Mat grid = bw / 255;
+		Mat image_path = grid.clone();
+		vector<LineMask> lines;
 		int n_lines = 0;
-		for (vector<int>::iterator itr = lines.begin(); itr != lines.end(); itr++) {
+		unsigned int n_paths = 0;
+		string prefix = filename.substr(filename.rfind('/') + 1);
+		prefix = prefix.substr(0, prefix.rfind('.')) + "/";
+		for (unsigned int k = 0; k < regions.size(); k++) {
 
-			clock_t _start = clock();
-
-			int end;
-			if ((map.grid.cols - 1) % 2 == 0) {
-				end = map.grid.cols - 1;
-			} else {
-				end = map.grid.cols - 2;
+			if (regions.size() > 1) {
+				cout << "- Column " << k + 1 << " [" << regions[k].area.x << ", " << regions[k].area.x + regions[k].area.width << ")" << endl;
 			}
+			cout << regions[k].log;
 
-			Node start{*itr, 0};
-			Node goal{*itr, end};
-
-			cout << "\t#" << to_string(distance(lines.begin(), itr) + 1) + " - from [" << get<0>(start) << ", " << get<1>(start) << "]";
-			cout << " to [" << get<0>(goal) << ", " << get<1>(goal) << "]";
-
-			unordered_map<Node, Node> parents;
-
-			astar_search(map, start, goal, parents, dataset_name, step, mfactor);
-
-			vector<Node> path = reconstruct_path(start, goal, parents);
-			draw_path(image_path, path);
+			for (auto path : regions[k].paths) {
+				vector<Map::Node> page_path = offset_path(path, regions[k].area);
+				mark_path(image_path, page_path);
+			}
 
 			// Segment the found text lines and save them as seperate images.
-			if (paths.size() >= 1) {  // use upper and lower boundary for segmentation
-				segment_text_line(image_path_original, "data/", ++n_lines, path, paths.back());
-			} else {  // use only lower bound for first line
-				segment_text_line(image_path_original, "data/", ++n_lines, true, path);
+			if (container.is_open()) {
+				for (unsigned int p = 0; p < regions[k].paths.size(); p++) {
+					container.append_path(prefix + "path_" + to_string(n_paths + p + 1), offset_path(regions[k].paths[p], regions[k].area));
+				}
+				n_paths += regions[k].paths.size();
+				if (!tight_crops) {
+					for (const Mat& image : region_line_images(grid, regions[k])) {
+						container.append_image(prefix + "line_" + to_string(++n_lines) + ".jpg", image, regions[k].area);
+					}
+				}
+			} else if (!tight_crops) {
+				save_region_lines(grid, regions[k], "data/", n_lines, &io);
 			}
+			if (flag_stats) {
+				mask_region_lines(grid, regions[k].area, regions[k].paths, lines);
+			}
+		}
 
-			paths.push_back(path);
-
-			clock_t _finish = clock();
-
-			cout << " ==> path found in " + to_string(double(_finish - _start) / CLOCKS_PER_SEC) << " s" << endl;
+		bool any_path = false;
+		for (const RegionPaths& region : regions) {
+			any_path = any_path or !region.paths.empty();
+		}
+		if (any_path) {
+			save_image("data/map.jpg", image_path*255, &io);
 		}
 
-		// Segment the last text line.
-		segment_text_line(image_path_original, "data/", ++n_lines, false, paths.back());
+		if (tight_crops and container.is_open()) {
+			for (const LineCrop& line : crop_page_lines(grid, regions).lines) {
+				Mat image = line.pixels > 0 ? line.image() : Mat(1, 1, CV_8U, Scalar(255));
+				container.append_image(prefix + "line_" + to_string(line.label) + ".jpg", image, line.box);
+			}
+		} else if (tight_crops) {
+			save_line_crops(crop_page_lines(grid, regions), "data/", &io);
+		}
 
 		if (flag_stats) {
 			cout << "- Computing statistics.." << endl;
-			compute_statistics(filename);
+			compute_statistics(filename, lines, grid.size(), &io, page.scale);
 		}
 
 		cout << "\n- Lines segmented and images saved." << endl;
@@ -148,12 +359,30 @@ int main (int argc, char* argv[]) {
 		clock_t end_for = clock();
 		double elapsed_secs = double(end_for - begin_for) / CLOCKS_PER_SEC;
 		cout << "\n- Elapsed Time: " << elapsed_secs << " s" << endl;
+		StageStats page_stats = page_meter.stop("page");
+		cout << "- Peak memory: " << format_bytes(page_stats.peak_bytes) << " (Mat buffers and search structures)" << endl;
+		if (page_stats.perf.any()) {
+			cout << "- Counters: " << format_perf(page_stats.perf) << endl;
+		}
 
 	}
 
+	if (io.drain() > 0) {
+		cout << "\tERROR! some output files could not be written" << endl;
+	}
+
+	if (container.is_open()) {
+		if (container.close()) {
+			cout << "\n- Lines and paths saved to " << container_path << endl;
+		} else {
+			cout << "\tERROR! could not write the index of " << container_path << endl;
+		}
+	}
+
 	clock_t end = clock();
 	double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
-	cout << "\n## Total Elapsed Time: " << elapsed_secs << " s ##\n" << endl;
+	cout << "\n## Total Elapsed Time: " << elapsed_secs << " s ##" << endl;
+	cout << "## Peak Memory: " << format_bytes((size_t) process_memory().peak.load()) << " ##\n" << endl;
 	cout << "########################################\n" << endl;
 
 	return 0;
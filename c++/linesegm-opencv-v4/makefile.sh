@@ -6,8 +6,10 @@ mkdir -p build
 
 # Set flags and libs used
 
-FLAGS="-D__GXX_EXPERIMENTAL_CXX0X__ -D__cplusplus=201103L"
-LIBS="-lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_imgcodecs"
+FLAGS="-D__GXX_EXPERIMENTAL_CXX0X__ -D__cplusplus=201103L -pthread"
+# Optimization flags, e.g. OPT="-O3 -march=native" ./makefile.sh for benchmarks
+OPT=${OPT:-"-O0 -g3"}
+LIBS="-lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_imgcodecs -pthread"
 
 # Build c++ files in the src folder
 
@@ -23,7 +25,7 @@ do
     echo "Invoking: GCC C++ Compiler"
     file=${i#$prefix}
     file=${file%$suffix}
-    CMD="g++ $FLAGS -I/usr/local/include -I/usr/local/include/opencv4 -O0 -g3 -Wall -c -fmessage-length=0 -std=c++11 -MMD -MP -MF build/$file.d -MT build/$file.d -o build/$file.o src/$file.cpp"
+    CMD="g++ $FLAGS -I/usr/local/include -I/usr/local/include/opencv4 $OPT -Wall -c -fmessage-length=0 -std=c++11 -MMD -MP -MF build/$file.d -MT build/$file.d -o build/$file.o src/$file.cpp"
     echo $CMD
     $CMD
     echo "Finished building: $i"
@@ -34,7 +36,7 @@ done
 
 echo "Building file: ./main.cpp"
 echo "Invoking: GCC C++ Compiler"
-CMD="g++ $FLAGS -I/usr/local/include -I/usr/local/include/opencv4 -O0 -g3 -Wall -c -fmessage-length=0 -std=c++11 -MMD -MP -MF build/main.d -MT build/main.d -o build/main.o main.cpp"
+CMD="g++ $FLAGS -I/usr/local/include -I/usr/local/include/opencv4 $OPT -Wall -c -fmessage-length=0 -std=c++11 -MMD -MP -MF build/main.d -MT build/main.d -o build/main.o main.cpp"
 echo $CMD
 $CMD
 echo "Finished building: ./main.cpp"
@@ -59,4 +61,13 @@ $CMD
 echo "Finished building target: ./bin/linesegm"
 echo " "
 
+# Build the groundtruth rasterizer, a single translation unit
+
+echo "Building target: ./bin/gtraster"
+CMD="g++ $FLAGS -I/usr/local/include -I/usr/local/include/opencv4 $OPT -Wall -fmessage-length=0 -std=c++11 -o ./bin/gtraster gtraster.cpp $LIBS"
+echo $CMD
+$CMD
+echo "Finished building target: ./bin/gtraster"
+echo " "
+
 echo "Build finished"
@@ -0,0 +1,130 @@
+/*
+ * assignment.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef ASSIGNMENT_CPP
+#define ASSIGNMENT_CPP
+
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+using namespace std;
+
+
+/*
+ * One to one assignment of `persons` to `objects` maximizing the total
+ * benefit, on a sparse benefit matrix in CSR form: the arcs of person i are
+ * cols/benefit[row_start[i], row_start[i + 1]). A person may also stay
+ * unassigned, at benefit 0.
+ *
+ * Hungarian method by shortest augmenting paths (as in Crouse's variant of
+ * Jonker-Volgenant), with a heap over the arcs instead of dense scans. Every
+ * person has a private dummy object worth 0, so an augmenting path always
+ * exists, and the shortest one usually stays among the few neighbouring
+ * lines, so the work grows with the number of arcs rather than with
+ * persons x objects. Returns the object of every person, -1 if unassigned.
+ */
+inline vector<int> optimal_assignment (int persons, int objects, const vector<int>& row_start, const vector<int>& cols,
+							   const vector<double>& benefit) {
+
+	typedef pair<double, int> Entry;
+	const double INF = numeric_limits<double>::infinity();
+	int n = objects + persons;  // the dummy of person i is object objects + i
+
+	vector<double> u(persons, 0), v(n, 0), dist(n, INF);
+	vector<int> owner(n, -1), assigned(persons, -1), path(n, -1);
+	vector<bool> scanned_row(persons, false), scanned_col(n, false);
+	vector<int> rows_seen, cols_seen;
+
+	for (int start = 0; start < persons; start++) {
+
+		priority_queue<Entry, vector<Entry>, greater<Entry>> heap;
+		double min_value = 0;
+		int sink = -1, i = start;
+
+		while (sink < 0) {
+			scanned_row[i] = true;
+			rows_seen.push_back(i);
+
+			// Relax the arcs of person i, its dummy included (cost 0); costs are -benefit.
+			for (int k = row_start[i]; k <= row_start[i + 1]; k++) {
+				int j = k < row_start[i + 1] ? cols[k] : objects + i;
+				double cost = k < row_start[i + 1] ? -benefit[k] : 0;
+				if (scanned_col[j]) {
+					continue;
+				}
+				double r = min_value + cost - u[i] - v[j];
+				if (r < dist[j]) {
+					if (dist[j] == INF) {
+						cols_seen.push_back(j);
+					}
+					dist[j] = r;
+					path[j] = i;
+					heap.push(Entry(r, j));
+				}
+			}
+
+			int j;
+			do {
+				j = heap.top().second;
+				min_value = heap.top().first;
+				heap.pop();
+			} while (scanned_col[j] or min_value > dist[j]);
+
+			scanned_col[j] = true;
+			if (owner[j] < 0) {
+				sink = j;
+			} else {
+				i = owner[j];
+			}
+		}
+
+		// Update the potentials of the scanned rows and columns.
+		u[start] += min_value;
+		for (int r : rows_seen) {
+			if (r != start) {
+				u[r] += min_value - dist[assigned[r]];
+			}
+		}
+		for (int c : cols_seen) {
+			if (scanned_col[c]) {
+				v[c] -= min_value - dist[c];
+			}
+		}
+
+		// Augment along the path back to the start.
+		for (int j = sink; ; ) {
+			int p = path[j];
+			owner[j] = p;
+			int previous = assigned[p];
+			assigned[p] = j;
+			if (p == start) {
+				break;
+			}
+			j = previous;
+		}
+
+		for (int r : rows_seen) {
+			scanned_row[r] = false;
+		}
+		for (int c : cols_seen) {
+			scanned_col[c] = false;
+			dist[c] = INF;
+		}
+		rows_seen.clear();
+		cols_seen.clear();
+	}
+
+	for (int i = 0; i < persons; i++) {
+		if (assigned[i] >= objects) {
+			assigned[i] = -1;
+		}
+	}
+	return assigned;
+}
+
+#endif
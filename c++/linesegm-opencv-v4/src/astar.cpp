@@ -5,8 +5,11 @@
  *      Author: saverio
  */
 
+#ifndef ASTAR_CPP
+#define ASTAR_CPP
 
 #include "opencv2/opencv.hpp"
+#include "bitgrid.cpp"
 #include <queue>
 #include <algorithm>
 #include <unordered_map>
@@ -17,42 +20,124 @@ using namespace cv;
 using namespace std;
 
 
+// Distance map entries saturate at 255, which stands for no ink in the column.
+inline int obstacle_distance (uchar dist) {
+	if (dist < 255) {
+		return (int) dist;
+	} else {
+		return INFINITY;
+	}
+}
+
 struct Map {
 
 	typedef tuple<int, int> Node;
-	Mat grid;
-	Mat dmat;
+	BitGrid walls;           // the ink, also the size of the map
+	Raster<uchar> distances;
+	Raster<ushort> free_runs;
+	Raster<float> costs;
+	BitGrid blocked;  // pixels no path may enter, empty if there are none
+	int clearance = 0;
 	Node directions[8] = {Node{-1, -1}, Node{-1, 0}, Node{-1, 1},
 						  Node{0, -1}, Node{0, 1},
 						  Node{1, -1}, Node{1, 0}, Node{1, 1}};
 
+	// Bytes held by the rasters of the map.
+	inline size_t bytes () const {
+		return walls.words.size() * sizeof(uint64_t) + distances.data.size() * sizeof(uchar)
+				+ free_runs.data.size() * sizeof(ushort) + costs.data.size() * sizeof(float) + blocked.words.size() * sizeof(uint64_t);
+	}
+
 	inline bool in_bounds (Node node) const {
 		int row, col;
 		tie (row, col) = node;
-		return 0 <= row and row < grid.rows and 0 <= col and col < grid.cols;
+		return 0 <= row and row < walls.rows and 0 <= col and col < walls.cols;
 	}
 
 	inline bool is_wall (Node node) const {
 		int row, col;
 		tie (row, col) = node;
-		return (int) grid.at<uchar>(row, col) == 0;
+		return walls.test(row, col);
+	}
+
+	// Whether a move of `stride` pixels in direction (dr, dc) from (row, col) enters a blocked pixel.
+	inline bool move_blocked (int row, int col, int dr, int dc, int stride) const {
+		if (blocked.empty()) {
+			return false;
+		}
+		for (int k = 1; k <= stride; k++) {
+			if (blocked.test(row + k*dr, col + k*dc)) {
+				return true;
+			}
+		}
+		return false;
 	}
 
 	inline int closest_vertical_obstacle (Node node) const {
-		int row, col, dist;
+		int row, col;
 		tie (row, col) = node;
-		dist = (int) dmat.at<uchar>(row, col);
-		if (dist < 255) {
-			return dist;
-		} else {
-			return INFINITY;
+		return obstacle_distance(distances.at(row, col));
+	}
+
+	// Columns from `node` rightwards that have no ink within the clearance
+	// free_runs was built with, 0 if run skipping is disabled.
+	inline int free_run (Node node) const {
+		int row, col;
+		tie (row, col) = node;
+		if (free_runs.empty()) {
+			return 0;
 		}
+		return (int) free_runs.at(row, col);
+	}
+
+	/*
+	 * Stride of the moves out of `node`. With a fixed step (clearance 0) this is
+	 * the step itself. In adaptive mode it is the largest of 8, 4 and 2 such that
+	 * every column within the stride keeps a vertical clearance of at least
+	 * clearance + stride, i.e. the box swept by the moves is free of ink, and 1
+	 * near obstacles.
+	 */
+	inline int stride (Node node, int step) const {
+		if (clearance <= 0) {
+			return step;
+		}
+
+		int row, col;
+		tie (row, col) = node;
+		int window_min[9];
+		window_min[0] = distances.at(row, col);
+		for (int k = 1; k <= 8; k++) {
+			if (col - k < 0 or col + k >= walls.cols) {
+				window_min[k] = 0;
+				continue;
+			}
+			window_min[k] = min(window_min[k - 1], (int) min(distances.at(row, col - k), distances.at(row, col + k)));
+		}
+
+		for (int s = 8; s >= 2; s /= 2) {
+			if (window_min[s] >= clearance + s) {
+				return s;
+			}
+		}
+		return 1;
+	}
+
+	// As above, but unit moves within the longest stride of `goal`, so it is landed on whatever its offset.
+	inline int stride (Node node, Node goal, int step) const {
+		int row, col, grow, gcol;
+		tie (row, col) = node;
+		tie (grow, gcol) = goal;
+		if (clearance > 0 and abs(row - grow) <= 8 and abs(col - gcol) <= 8) {
+			return 1;
+		}
+		return stride(node, step);
 	}
 
 	vector<Node> neighbors(Node node, int step) const {
 		int row, col, dr, dc;
 		tie (row, col) = node;
 		vector<Node> neighbors;
+		step = stride(node, step);
 
 		for (auto dir : directions) {
 			tie (dr, dc) = dir;
@@ -66,11 +151,30 @@ struct Map {
 
 };
 
+/*
+ * Per-row "next ink column" index: for every pixel, how many columns to its
+ * right (itself included) keep a vertical clearance of at least `clearance`
+ * in the distance map, i.e. how far the search can run along the row
+ * without getting close to ink. Saturates at 65535.
+ */
+inline Raster<ushort> compute_free_runs (const Mat& dmat, int clearance, RasterLayout layout) {
+	Raster<ushort> runs(dmat.rows, dmat.cols, layout, 0);
+	for (int i = 0; i < dmat.rows; i++) {
+		const uchar* d = dmat.ptr<uchar>(i);
+		int run = 0;
+		for (int j = dmat.cols - 1; j >= 0; j--) {
+			run = (int) d[j] >= clearance ? min(run + 1, 65535) : 0;
+			runs.at(i, j) = (ushort) run;
+		}
+	}
+	return runs;
+}
+
 template<typename T, typename Priority = double>
 struct PriorityQueue {
 
 	typedef pair<Priority, T> Element;
-	priority_queue<Element, vector<Element>, greater<Element>> elements;
+	priority_queue<Element, TrackedVector<Element>, greater<Element>> elements;
 
 	inline bool empty () {
 		return elements.empty();
@@ -86,6 +190,15 @@ struct PriorityQueue {
 		return element;
 	}
 
+	inline T get (Priority& priority) {
+		priority = elements.top().first;
+		return get();
+	}
+
+	inline Priority top_priority () {
+		return elements.top().first;
+	}
+
 };
 
 template<typename Node>
@@ -128,28 +241,95 @@ inline double M (const Graph& graph, typename Graph::Node node) {
 	}
 }
 
-template<typename Graph>
-inline tuple<double, double> D (const Graph& graph, typename Graph::Node node) {
-	double min = (double) graph.closest_vertical_obstacle(node);
+inline tuple<double, double> D (double min) {
 	tuple<double, double> ds{1 / (1 + min), 1 / (1 + pow(min, 2))};
 	return ds;
 }
 
 template<typename Graph>
-inline double compute_cost (const Graph& graph, typename Graph::Node current, typename Graph::Node neighbor, typename Graph::Node start, string dataset) {
+inline tuple<double, double> D (const Graph& graph, typename Graph::Node node) {
+	return D((double) graph.closest_vertical_obstacle(node));
+}
+
+/*
+ * Weights of the terms of the cost: V (distance from the start row), N (move
+ * length), M (ink) and the two distance to ink terms of D.
+ */
+struct CostWeights {
+
+	double vertical;
+	double neighbor;
+	double ink;
+	double distance;
+	double distance2;
+
+	CostWeights () : vertical(0.5), neighbor(1), ink(50), distance(150), distance2(50) {}
+
+	// Only these three are baked into the cost field.
+	inline bool same_node_terms (const CostWeights& other) const {
+		return ink == other.ink and distance == other.distance and distance2 == other.distance2;
+	}
+
+};
+
+inline CostWeights dataset_weights (string dataset) {
+	CostWeights weights;
+	if (strcmp(dataset.c_str(), "MLS") == 0) {
+		weights.vertical = 2.5;
+		weights.distance = 130;
+		weights.distance2 = 0;
+	}
+	// else: 3*v + 1*n + 50*m + 150*d + 50*d2 was tried too
+	return weights;
+}
+
+// The terms of the cost that depend on the neighbor alone (ink and distance to ink).
+inline double node_cost (double m, double d, double d2, const CostWeights& weights) {
+	return weights.ink*m + weights.distance*d + weights.distance2*d2;
+}
+
+// node_cost of a free (0) or ink (1) pixel for each of the 256 distance map values.
+inline void cost_table (const CostWeights& weights, float table[2][256]) {
+	for (int v = 0; v < 256; v++) {
+		double d, d2;
+		tie (d, d2) = D((double) obstacle_distance((uchar) v));
+		table[0][v] = (float) node_cost(0, d, d2, weights);
+		table[1][v] = (float) node_cost(1, d, d2, weights);
+	}
+}
+
+/*
+ * Precomputes node_cost for every pixel. The distance terms only take 256
+ * values, so they are tabulated. The A* search and the DP solver both read
+ * this raster through compute_cost, which then ignores the node weights it
+ * is given: the field must be built with the same ones.
+ */
+inline Raster<float> compute_cost_field (const Map& graph, const CostWeights& weights, RasterLayout layout) {
+	float table[2][256];
+	cost_table(weights, table);
+
+	Raster<float> costs(graph.walls.rows, graph.walls.cols, layout);
+	for (int i = 0; i < graph.walls.rows; i++) {
+		for (int j = 0; j < graph.walls.cols; j++) {
+			costs.at(i, j) = table[graph.walls.test(i, j)][graph.distances.at(i, j)];
+		}
+	}
+	return costs;
+}
+
+template<typename Graph>
+inline double compute_cost (const Graph& graph, typename Graph::Node current, typename Graph::Node neighbor, typename Graph::Node start, const CostWeights& weights) {
 	double v = V(neighbor, start);
 	double n = N(current, neighbor);
-	double m = M(graph, neighbor);
-	tuple<double, double> ds = D(graph, neighbor);
-	double d, d2;
-	tie (d, d2) = ds;
 
-	if (strcmp(dataset.c_str(), "MLS") == 0) {
-		return 2.5*v + 1*n + 50*m + 130*d + 0*d2;
-	} else {
-		// return 3*v + 1*n + 50*m + 150*d + 50*d2;
-		return 0.5*v + 1*n + 50*m + 150*d + 50*d2;
+	if (!graph.costs.empty()) {
+		return weights.vertical*v + weights.neighbor*n + graph.costs.at(get<0>(neighbor), get<1>(neighbor));
 	}
+
+	double m = M(graph, neighbor);
+	double d, d2;
+	tie (d, d2) = D(graph, neighbor);
+	return weights.vertical*v + weights.neighbor*n + node_cost(m, d, d2, weights);
 }
 
 namespace std {
@@ -163,53 +343,212 @@ namespace std {
   };
 }
 
-template<typename Node>
-inline vector<Node> reconstruct_path (Node start, Node goal, unordered_map<Node, Node>& parents) {
+/*
+ * Dense per-node search state over a window of the page: the g-score as a
+ * float and one byte per node packing the index of the direction (in
+ * Map::directions) the node was reached from, the log2 of the stride of that
+ * move and a reached flag. The state is allocated once and reused for every
+ * line; reset() only clears the nodes touched by the previous search.
+ */
+struct SearchState {
+
+	enum { DIR_MASK = 0x07, STRIDE_SHIFT = 3, STRIDE_MASK = 0x18, REACHED = 0x20 };
+
+	Rect window;
+	Raster<float> gscore;
+	Raster<uchar> parents;
+	vector<size_t> touched;
+
+	SearchState () {}
+
+	SearchState (Rect window, RasterLayout layout) : window(window),
+			gscore(window.height, window.width, layout), parents(window.height, window.width, layout, 0) {}
+
+	inline bool contains (int row, int col) const {
+		return window.y <= row and row < window.y + window.height and window.x <= col and col < window.x + window.width;
+	}
+
+	inline size_t index (int row, int col) const {
+		return parents.index(row - window.y, col - window.x);
+	}
+
+	inline bool reached (size_t i) const {
+		return parents.data[i] & REACHED;
+	}
+
+	inline void reach (size_t i, float g, int dir, int stride_log) {
+		if (!reached(i)) {
+			touched.push_back(i);
+		}
+		parents.data[i] = (uchar) (REACHED | (stride_log << STRIDE_SHIFT) | dir);
+		gscore.data[i] = g;
+	}
+
+	inline void reset () {
+		if (touched.size() > parents.data.size() / 8) {
+			parents.fill(0);
+		} else {
+			for (size_t i : touched) {
+				parents.data[i] = 0;
+			}
+		}
+		touched.clear();
+	}
+
+};
+
+/*
+ * The moves of the adaptive stride are filled in, so its paths are
+ * 8-connected. With a fixed step the path keeps one node per move, as the
+ * later stages have always read it.
+ */
+template<typename Graph>
+inline vector<typename Graph::Node> reconstruct_path (const Graph& graph, typename Graph::Node start, typename Graph::Node goal,
+											  const SearchState& state) {
+	typedef typename Graph::Node Node;
 	vector<Node> path;
+	int row, col, dr, dc;
+	tie (row, col) = goal;
+	if (!state.contains(row, col) or !state.reached(state.index(row, col))) {
+		return path;
+	}
+
 	Node current = goal;
 	path.push_back(current);
 	while (current != start) {
-		current = parents[current];
-		path.push_back(current);
+		uchar code = state.parents.data[state.index(row, col)];
+		int stride = 1 << ((code & SearchState::STRIDE_MASK) >> SearchState::STRIDE_SHIFT);
+		tie (dr, dc) = graph.directions[code & SearchState::DIR_MASK];
+		for (int k = 0; k < stride; k++) {
+			row -= dr;
+			col -= dc;
+			if (graph.clearance > 0 or k == stride - 1) {
+				path.push_back(Node(row, col));
+			}
+		}
+		current = Node(row, col);
 	}
 
 	reverse(path.begin(), path.end());
 	return path;
 }
 
+/*
+ * Macro-move across a free run: walks east along the row of `current` in
+ * steps of `step` up to the end of the run (or the goal column), summing
+ * the exact cost of every step, in place of the single move east. Every
+ * node passed over gets the g-score and parent the chain of moves east
+ * would give it and is pushed, so its other exits are still expanded and,
+ * as long as the heuristic does not overestimate, the path costs the same
+ * as without skipping. The walk stops at a node already reached at least
+ * as cheaply, whose own expansion continues it. Returns false if there is
+ * no run to skip.
+ */
+template<typename Graph>
+inline bool skip_free_run (const Graph& graph, typename Graph::Node current, typename Graph::Node start, typename Graph::Node goal,
+					SearchState& state, PriorityQueue<typename Graph::Node>& openSet, const CostWeights& weights, int step, int mfactor) {
+
+	typedef typename Graph::Node Node;
+	int row, col, grow, gcol;
+	tie (row, col) = current;
+	tie (grow, gcol) = goal;
+
+	int run = graph.free_run(current);
+	if (run < 2*step or gcol <= col) {
+		return false;
+	}
+	int last = min(col + ((run - 1) / step) * step, col + ((gcol - col) / step) * step);
+	if (last - col < 2*step) {
+		return false;
+	}
+
+	const int east = 4;
+	int stride_log = __builtin_ctz(step);
+	// Kept as stored, so the walk stops as soon as it reaches a node it already wrote.
+	float g = state.gscore.data[state.index(row, col)];
+	Node prev = current;
+	for (int c = col + step; c <= last and state.contains(row, c); c += step) {
+		Node next(row, c);
+		if (graph.move_blocked(row, c - step, 0, 1, step)) {
+			break;
+		}
+		float new_gscore = (float) (g + compute_cost(graph, prev, next, start, weights));
+		size_t i = state.index(row, c);
+		if (state.reached(i) and state.gscore.data[i] <= new_gscore) {
+			break;
+		}
+		state.reach(i, new_gscore, east, stride_log);
+		openSet.put(next, new_gscore + heuristic(next, goal, mfactor));
+		g = new_gscore;
+		prev = next;
+	}
+	return true;
+}
+
 template<typename Graph>
-inline void astar_search (const Graph& graph, typename Graph::Node start, typename Graph::Node goal,
-				   unordered_map<typename Graph::Node, typename Graph::Node>& parents, string dataset_name, int step, int mfactor) {
+inline size_t astar_search (const Graph& graph, typename Graph::Node start, typename Graph::Node goal,
+				   SearchState& state, const CostWeights& weights, int step, int mfactor) {
 
 	typedef typename Graph::Node Node;
-	unordered_map<Node, double> gscore;
-	unordered_set<Node> closedSet;
 	PriorityQueue<Node> openSet;
+	int row, col, dr, dc;
+	size_t expansions = 0;
+
+	state.reset();
+	tie (row, col) = start;
+	state.reach(state.index(row, col), 0, 0, 0);
 	openSet.put(start, 0);
-	gscore[start] = 0;
 
 	while (not openSet.empty()) {
 
-		auto current = openSet.get();
+		double priority;
+		auto current = openSet.get(priority);
+		tie (row, col) = current;
+		float gcurrent = state.gscore.data[state.index(row, col)];
+
+		// Skip the entries left behind when a node was reached again more cheaply.
+		if (priority > gcurrent + heuristic(current, goal, mfactor)) {
+			continue;
+		}
 
 		if (current == goal) {
 			break;
 		}
 
-		for (auto neighbor : graph.neighbors(current, step)) {
+		expansions++;
+
+		// Away from ink the plain move east is replaced by a single jump to the end of the free run.
+		bool skipped = skip_free_run(graph, current, start, goal, state, openSet, weights, step, mfactor);
+
+		// Longer strides are only taken in adaptive mode; their cost is scaled by the
+		// stride so that it stays comparable with a chain of unit moves.
+		int stride = graph.stride(current, goal, step);
+		int stride_log = __builtin_ctz(stride);
+		double scale = graph.clearance > 0 ? stride : 1;
 
-			if (closedSet.count(neighbor)) {
+		for (int d = 0; d < 8; d++) {
+
+			tie (dr, dc) = graph.directions[d];
+			if (skipped and dr == 0 and dc == 1) {
+				continue;
+			}
+			Node neighbor(row + stride*dr, col + stride*dc);
+			if (!graph.in_bounds(neighbor) or !state.contains(row + stride*dr, col + stride*dc)
+					or graph.move_blocked(row, col, dr, dc, stride)) {
 				continue;
 			}
 
-			double new_gscore = gscore[current] + compute_cost(graph, current, neighbor, start, dataset_name); //heuristic(current, neighbor);
-			if (!gscore.count(neighbor) or new_gscore < gscore[neighbor]) {
-				gscore[neighbor] = new_gscore;
-				parents[neighbor] = current;
-				double fscore = new_gscore + heuristic(neighbor, goal, mfactor);
+			size_t i = state.index(row + stride*dr, col + stride*dc);
+			double new_gscore = gcurrent + scale * compute_cost(graph, current, neighbor, start, weights);
+			if (!state.reached(i) or new_gscore < state.gscore.data[i]) {
+				state.reach(i, (float) new_gscore, d, stride_log);
+				double fscore = state.gscore.data[i] + heuristic(neighbor, goal, mfactor);
 				openSet.put(neighbor, fscore);
 			}
 		}
 	}
 
+	return expansions;
 }
+
+#endif
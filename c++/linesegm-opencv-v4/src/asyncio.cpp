@@ -0,0 +1,538 @@
+/*
+ * asyncio.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef ASYNCIO_CPP
+#define ASYNCIO_CPP
+
+#include "opencv2/opencv.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define LINESEGM_IO_URING 1
+#endif
+
+using namespace cv;
+using namespace std;
+
+
+// A whole file read into `data`, or `data` written (or appended) to a file.
+struct IoRequest {
+
+	string path;
+	vector<uchar> data;
+	bool write;
+	bool append;
+	bool done;
+	bool ok;
+	int fd;
+	size_t offset;  // bytes transferred so far
+	bool submitted;  // in the io_uring, waiting for its completion
+	struct iovec iov;
+	shared_ptr<IoRequest> next;  // the following request on the same path, started once this one is done
+
+	IoRequest () : write(false), append(false), done(false), ok(false), fd(-1), offset(0), submitted(false) {}
+
+};
+
+/*
+ * Batched file reads and writes off the compute thread. Requests go to an
+ * io_uring, set up with raw syscalls so no library is needed, with up to
+ * `depth` of them in flight; files are opened (and, for reads, sized) by
+ * the caller and the data moves asynchronously. Where io_uring is not
+ * available (old kernel, seccomp, or `ring` false) a pool of `threads`
+ * workers does blocking reads and writes instead. Short transfers are
+ * resumed; a request is done once all of its bytes are moved or it failed.
+ * Requests on the same path run one after the other in the order they were
+ * made, so a file rewritten for every page is never truncated under a
+ * write still in flight and appends land in order. Completions are reaped
+ * whenever a request is made or waited for. If the ring cannot be entered
+ * any more, the requests in it fail and the thread pool takes over.
+ */
+class AsyncIo {
+
+	mutex lock;
+	condition_variable finished;
+	vector<shared_ptr<IoRequest>> active;
+	map<string, shared_ptr<IoRequest>> last;  // the latest request of every path with one not done
+	deque<shared_ptr<IoRequest>> chained;  // requests whose predecessor on the path is done, to be issued
+	size_t failures;
+
+	// Thread pool backend.
+	int threads;
+	vector<thread> workers;
+	deque<shared_ptr<IoRequest>> queue;
+	bool stopping;
+
+	// io_uring backend.
+	int ring_fd;
+	unsigned entries;
+	unsigned inflight;
+	unsigned unsubmitted;
+	void* sq_ptr;
+	void* cq_ptr;
+	size_t sq_size;
+	size_t cq_size;
+	void* sqes;
+	size_t sqes_size;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	void* cqes;
+	vector<shared_ptr<IoRequest>> orphans;  // failed while in a ring that was given up, kept until it is closed
+
+	static const int ENTER_RETRIES = 64;
+
+	inline void finish (IoRequest* request, bool ok) {
+		if (request->fd >= 0) {
+			ok = ::close(request->fd) == 0 and ok;
+			request->fd = -1;
+		}
+		if (!request->write and ok) {
+			request->data.resize(request->offset);
+		}
+		request->ok = ok;
+		request->done = true;
+		failures += !ok;
+		if (request->next) {
+			chained.push_back(request->next);
+			request->next.reset();
+		} else {
+			last.erase(request->path);
+		}
+		// The request may be freed here, if only the active list held it.
+		for (size_t k = 0; k < active.size(); k++) {
+			if (active[k].get() == request) {
+				active[k] = active.back();
+				active.pop_back();
+				break;
+			}
+		}
+		finished.notify_all();
+	}
+
+	/*
+	 * Issues the requests queued by finish once their predecessor was done.
+	 * They are not issued from finish itself, which runs inside reap.
+	 */
+	inline void issue_chained () {
+		while (!chained.empty()) {
+			shared_ptr<IoRequest> request = chained.front();
+			chained.pop_front();
+			issue(request);
+		}
+	}
+
+	// Opens the file of a request; a read is sized so its buffer can be allocated up front.
+	inline bool open_file (IoRequest& request) {
+		if (request.write) {
+			request.fd = ::open(request.path.c_str(), O_WRONLY | O_CREAT | (request.append ? O_APPEND : O_TRUNC), 0644);
+			return request.fd >= 0;
+		}
+		request.fd = ::open(request.path.c_str(), O_RDONLY);
+		struct stat st;
+		if (request.fd < 0 or fstat(request.fd, &st) != 0) {
+			return false;
+		}
+		request.data.resize((size_t) st.st_size);
+		return true;
+	}
+
+	// Blocking transfer, run by the pool workers.
+	static inline bool transfer (IoRequest& request) {
+		while (request.offset < request.data.size()) {
+			uchar* p = request.data.data() + request.offset;
+			size_t left = request.data.size() - request.offset;
+			ssize_t n = request.write ? ::write(request.fd, p, left) : ::read(request.fd, p, left);
+			if (n < 0 and errno == EINTR) {
+				continue;
+			}
+			if (n < 0) {
+				return false;
+			}
+			if (n == 0) {
+				break;  // the file got shorter since it was sized
+			}
+			request.offset += (size_t) n;
+		}
+		return true;
+	}
+
+	inline void work () {
+		unique_lock<mutex> guard(lock);
+		while (true) {
+			finished.wait(guard, [this] () { return stopping or !queue.empty(); });
+			if (queue.empty()) {
+				return;
+			}
+			shared_ptr<IoRequest> request = queue.front();
+			queue.pop_front();
+			guard.unlock();
+			bool ok = transfer(*request);
+			guard.lock();
+			finish(request.get(), ok);
+			issue_chained();
+		}
+	}
+
+	inline void start_workers () {
+		for (int t = 0; t < max(threads, 1); t++) {
+			workers.push_back(thread(&AsyncIo::work, this));
+		}
+	}
+
+#ifdef LINESEGM_IO_URING
+
+	inline bool setup_ring (unsigned depth) {
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		ring_fd = (int) syscall(__NR_io_uring_setup, depth, &params);
+		if (ring_fd < 0) {
+			return false;
+		}
+		entries = params.sq_entries;
+		sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (single) {
+			sq_size = cq_size = max(sq_size, cq_size);
+		}
+		sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		cq_ptr = single ? sq_ptr : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+		sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+		if (sq_ptr == MAP_FAILED or cq_ptr == MAP_FAILED or sqes == MAP_FAILED) {
+			close_ring();
+			return false;
+		}
+
+		char* sq = (char*) sq_ptr;
+		char* cq = (char*) cq_ptr;
+		sq_tail = (unsigned*) (sq + params.sq_off.tail);
+		sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+		sq_array = (unsigned*) (sq + params.sq_off.array);
+		cq_head = (unsigned*) (cq + params.cq_off.head);
+		cq_tail = (unsigned*) (cq + params.cq_off.tail);
+		cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+		cqes = cq + params.cq_off.cqes;
+		return true;
+	}
+
+	inline void close_ring () {
+		if (sqes and sqes != MAP_FAILED) {
+			munmap(sqes, sqes_size);
+		}
+		if (cq_ptr and cq_ptr != MAP_FAILED and cq_ptr != sq_ptr) {
+			munmap(cq_ptr, cq_size);
+		}
+		if (sq_ptr and sq_ptr != MAP_FAILED) {
+			munmap(sq_ptr, sq_size);
+		}
+		sqes = sq_ptr = cq_ptr = nullptr;
+		if (ring_fd >= 0) {
+			::close(ring_fd);
+			ring_fd = -1;
+		}
+	}
+
+	/*
+	 * Gives up the ring after io_uring_enter failed with `error`: the
+	 * requests in it fail, and the thread pool serves the ones still to be
+	 * issued and every later one. The buffers of the failed requests are
+	 * kept until the ring is closed, in case the kernel still holds them.
+	 */
+	inline void fall_back (int error) {
+		cout << "\tERROR! io_uring_enter: " << strerror(error) << ", moving to the thread pool" << endl;
+		vector<shared_ptr<IoRequest>> lost;
+		for (const shared_ptr<IoRequest>& request : active) {
+			if (request->submitted) {
+				lost.push_back(request);
+			}
+		}
+		for (const shared_ptr<IoRequest>& request : lost) {
+			request->submitted = false;
+			orphans.push_back(request);
+			finish(request.get(), false);
+		}
+		inflight = unsubmitted = 0;
+		close_ring();
+		start_workers();
+		issue_chained();
+	}
+
+	/*
+	 * Submits everything queued and, if `wait`, blocks until at least one
+	 * completion. Interrupted or busy calls are retried ENTER_RETRIES times
+	 * at most, any other error gives up the ring.
+	 */
+	inline void enter (bool wait) {
+		for (int attempt = 0; ring_fd >= 0; attempt++) {
+			long ret = syscall(__NR_io_uring_enter, ring_fd, unsubmitted, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (ret >= 0) {
+				unsubmitted -= min((unsigned) ret, unsubmitted);
+				return;
+			}
+			int error = errno;
+			if ((error != EINTR and error != EAGAIN and error != EBUSY) or attempt >= ENTER_RETRIES) {
+				fall_back(error);
+				return;
+			}
+			if (error != EINTR) {
+				reap();  // the completion queue is full, make room
+			}
+		}
+	}
+
+	// Puts a request in the ring, waiting for a free entry. Returns false if the ring was given up meanwhile.
+	inline bool queue_sqe (IoRequest* request) {
+		while (ring_fd >= 0 and inflight >= entries) {
+			enter(true);
+			reap();
+		}
+		if (ring_fd < 0) {
+			return false;
+		}
+		request->iov.iov_base = request->data.data() + request->offset;
+		request->iov.iov_len = request->data.size() - request->offset;
+
+		unsigned tail = *sq_tail;
+		unsigned index = tail & *sq_mask;
+		struct io_uring_sqe* sqe = (struct io_uring_sqe*) sqes + index;
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->fd = request->fd;
+		sqe->addr = (uint64_t) (uintptr_t) &request->iov;
+		sqe->len = 1;
+		sqe->off = request->offset;
+		sqe->user_data = (uint64_t) (uintptr_t) request;
+		sq_array[index] = index;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+		request->submitted = true;
+		inflight++;
+		unsubmitted++;
+		return true;
+	}
+
+	/*
+	 * Handles the completions in the queue without blocking. A short transfer
+	 * is resubmitted into the entry its completion just freed, and requests
+	 * chained behind a finished one are left to issue_chained.
+	 */
+	inline void reap () {
+		if (ring_fd < 0) {
+			return;
+		}
+		unsigned head = *cq_head;
+		while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe* cqe = (struct io_uring_cqe*) cqes + (head & *cq_mask);
+			IoRequest* request = (IoRequest*) (uintptr_t) cqe->user_data;
+			int res = cqe->res;
+			__atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+			request->submitted = false;
+			inflight--;
+
+			if (res == -EINTR or res == -EAGAIN) {
+				queue_sqe(request);
+			} else if (res < 0) {
+				finish(request, false);
+			} else if (res == 0 and request->offset < request->data.size()) {
+				finish(request, !request->write);  // a read hit the end of a file that got shorter
+			} else {
+				request->offset += (size_t) res;
+				if (request->offset < request->data.size()) {
+					queue_sqe(request);
+				} else {
+					finish(request, true);
+				}
+			}
+			head = *cq_head;
+		}
+	}
+
+#else
+
+	inline bool setup_ring (unsigned) {
+		return false;
+	}
+
+	inline void close_ring () {}
+
+	inline void enter (bool) {}
+
+	inline bool queue_sqe (IoRequest*) {
+		return false;
+	}
+
+	inline void reap () {}
+
+#endif
+
+	inline void start (shared_ptr<IoRequest> request) {
+		active.push_back(request);
+		shared_ptr<IoRequest>& previous = last[request->path];
+		if (previous) {
+			previous->next = request;
+			previous = request;
+		} else {
+			previous = request;
+			issue(request);
+		}
+	}
+
+	inline void issue (shared_ptr<IoRequest> request) {
+		if (!open_file(*request)) {
+			finish(request.get(), false);
+		} else if (ring_fd >= 0 and request->data.empty()) {
+			finish(request.get(), true);
+		} else if (ring_fd < 0 or !queue_sqe(request.get())) {
+			queue.push_back(request);
+			finished.notify_all();
+		}
+	}
+
+	// Reaps what completed, issues what that unblocked and submits it, all without blocking.
+	inline void progress () {
+		reap();
+		issue_chained();
+		if (ring_fd >= 0 and unsubmitted > 0) {
+			enter(false);
+		}
+	}
+
+public:
+
+	explicit AsyncIo (unsigned depth = 64, int threads = 4, bool ring = true) : failures(0), threads(threads), stopping(false), ring_fd(-1),
+			entries(0), inflight(0), unsubmitted(0), sq_ptr(nullptr), cq_ptr(nullptr), sq_size(0), cq_size(0), sqes(nullptr),
+			sqes_size(0), sq_tail(nullptr), sq_mask(nullptr), sq_array(nullptr), cq_head(nullptr), cq_tail(nullptr),
+			cq_mask(nullptr), cqes(nullptr) {
+		if (!ring or !setup_ring(max(depth, 1u))) {
+			start_workers();
+		}
+	}
+
+	AsyncIo (const AsyncIo&) = delete;
+	AsyncIo& operator= (const AsyncIo&) = delete;
+
+	~AsyncIo () {
+		drain();
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+		}
+		finished.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		close_ring();
+	}
+
+	inline const char* backend () const {
+		return ring_fd >= 0 ? "io_uring" : "thread pool";
+	}
+
+	// Starts reading the whole of every file, submitted as one batch.
+	inline vector<shared_ptr<IoRequest>> read (const vector<string>& paths) {
+		vector<shared_ptr<IoRequest>> requests;
+		lock_guard<mutex> guard(lock);
+		for (const string& path : paths) {
+			requests.push_back(make_shared<IoRequest>());
+			requests.back()->path = path;
+			start(requests.back());
+		}
+		progress();
+		return requests;
+	}
+
+	inline shared_ptr<IoRequest> read (string path) {
+		return read(vector<string>{path})[0];
+	}
+
+	// Starts writing `data` to `path`, replacing it or appending to it.
+	inline shared_ptr<IoRequest> write (string path, vector<uchar> data, bool append = false) {
+		shared_ptr<IoRequest> request = make_shared<IoRequest>();
+		request->path = path;
+		request->data.swap(data);
+		request->write = true;
+		request->append = append;
+		lock_guard<mutex> guard(lock);
+		start(request);
+		progress();
+		return request;
+	}
+
+	// Blocks until `request` is done. Returns whether it succeeded.
+	inline bool wait (const shared_ptr<IoRequest>& request) {
+		unique_lock<mutex> guard(lock);
+		while (!request->done) {
+			if (ring_fd >= 0) {
+				progress();
+				if (!request->done and ring_fd >= 0) {
+					enter(true);
+				}
+			} else {
+				finished.wait(guard);
+			}
+		}
+		progress();  // the requests queued behind it on the same path
+		return request->ok;
+	}
+
+	// Blocks until every request is done. Returns the number that failed since the last drain.
+	inline size_t drain () {
+		unique_lock<mutex> guard(lock);
+		while (!active.empty()) {
+			if (ring_fd >= 0) {
+				progress();
+				if (!active.empty() and ring_fd >= 0) {
+					enter(true);
+				}
+			} else {
+				finished.wait(guard);
+			}
+		}
+		size_t failed = failures;
+		failures = 0;
+		return failed;
+	}
+
+};
+
+/*
+ * Writes `image` to `path` through `io` if given, encoded on the calling
+ * thread as the extension of the path says, or with imwrite otherwise.
+ */
+inline void save_image (string path, const Mat& image, AsyncIo* io) {
+	if (!io) {
+		imwrite(path, image);
+		return;
+	}
+	vector<uchar> encoded;
+	size_t dot = path.rfind('.');
+	if (dot != string::npos and imencode(path.substr(dot), image, encoded)) {
+		io->write(path, move(encoded));
+	}
+}
+
+#endif
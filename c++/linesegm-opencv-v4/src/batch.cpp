@@ -0,0 +1,111 @@
+/*
+ * batch.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BATCH_CPP
+#define BATCH_CPP
+
+#include "opencv2/opencv.hpp"
+#include "pipeline.cpp"
+#include "evaluation.cpp"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Segments and evaluates `filenames` on `jobs` threads without writing any
+ * image. The threads take pages from a shared counter and each keeps its
+ * own stats rows, so nothing is locked while pages are processed. The page
+ * logs are printed and the rows appended to the stats.csv of their dataset
+ * in input order once every page is done. The result does not depend on
+ * the scheduling.
+ */
+inline void evaluate_dataset (const vector<string>& filenames, const PageOptions& page, const SearchOptions& options, int jobs) {
+
+	typedef pair<size_t, PageStats> Row;
+	vector<vector<Row>> rows(jobs);
+	vector<string> logs(filenames.size());
+	atomic<size_t> next(0);
+
+	auto work = [&] (int t) {
+		SearchOptions page_options = options;
+		for (size_t k = next++; k < filenames.size(); k = next++) {
+
+			ostringstream log;
+			string filename = filenames[k];
+			select_dataset(page_options, filename);
+			log << "\n===============================================================" << endl;
+			log << "Page '" << filename << "' (" << page_options.dataset << ")" << endl;
+
+			Mat im = imread(filename, 0);
+			if (im.empty()) {
+				log << "\tERROR! could not read the image" << endl;
+				logs[k] = log.str();
+				continue;
+			}
+
+			vector<RegionPaths> regions = segment_page(im, page, page_options, log);
+			Mat grid = im / 255;
+			vector<LineMask> lines;
+			for (const RegionPaths& region : regions) {
+				log << region.log;
+				mask_region_lines(grid, region.area, region.paths, lines);
+			}
+
+			string name = page_name(filename, page_options.dataset);
+			GroundtruthStore store;
+			if (load_groundtruth("data/" + page_options.dataset + "/groundtruth/" + name + "/", grid.size(), store, page.scale)) {
+				LineOverlaps overlaps = compute_overlaps(groundtruth_masks(store), lines);
+				rows[t].push_back(Row(k, evaluate_page(name, store.names(), overlaps, log)));
+			}
+			logs[k] = log.str();
+		}
+	};
+
+	vector<thread> workers;
+	for (int t = 0; t < jobs; t++) {
+		workers.push_back(thread(work, t));
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	vector<Row> merged;
+	for (auto& sink : rows) {
+		merged.insert(merged.end(), sink.begin(), sink.end());
+	}
+	sort(merged.begin(), merged.end(), [] (const Row& a, const Row& b) { return a.first < b.first; });
+
+	for (const string& log : logs) {
+		cout << log;
+	}
+
+	map<string, vector<PageStats>> by_dataset;
+	double hitrate = 0, detection_gt = 0, detection_r = 0;
+	for (const Row& row : merged) {
+		by_dataset[infer_dataset(filenames[row.first])].push_back(row.second);
+		hitrate += row.second.hitrate;
+		detection_gt += row.second.detection_gt;
+		detection_r += row.second.detection_r;
+	}
+	for (auto& dataset : by_dataset) {
+		append_stats(dataset.first, dataset.second);
+	}
+
+	if (!merged.empty()) {
+		cout << "\n## Dataset avg. over " << merged.size() << " pages ==> ";
+		cout << " Hit rate: " << to_string(hitrate / merged.size());
+		cout << " - Line detection GT: " << to_string(detection_gt / merged.size());
+		cout << " - Line detection R: " << to_string(detection_r / merged.size()) << endl;
+	}
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * bitgrid.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BITGRID_CPP
+#define BITGRID_CPP
+
+#include "opencv2/opencv.hpp"
+#include "raster.cpp"
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Binary occupancy packed at one bit per pixel, 64 pixels per word.
+ * A set bit marks a wall (an ink pixel, i.e. a 0 in the 0/1 grid);
+ * the padding bits past the last column of every row are kept clear.
+ * In the TILED layout the words of one 64 column strip are stored
+ * contiguously, so vertically adjacent pixels are adjacent words.
+ */
+struct BitGrid {
+
+	int rows;
+	int cols;
+	int words_per_row;
+	RasterLayout layout;
+	TrackedVector<uint64_t> words;
+
+	BitGrid () : rows(0), cols(0), words_per_row(0), layout(ROW_MAJOR) {}
+
+	BitGrid (int rows, int cols, RasterLayout layout = ROW_MAJOR) : rows(rows), cols(cols),
+			words_per_row((cols + 63) / 64), layout(layout), words((size_t) rows * ((cols + 63) / 64), 0) {}
+
+	// Packs a CV_8U 0/1 grid (or a 0/255 image): every zero pixel becomes a wall.
+	explicit BitGrid (const Mat& grid, RasterLayout layout = ROW_MAJOR) : BitGrid(grid.rows, grid.cols, layout) {
+		for (int i = 0; i < rows; i++) {
+			const uchar* src = grid.ptr<uchar>(i);
+			for (int w = 0; w < words_per_row; w++) {
+				int c0 = w * 64;
+				int c1 = min(c0 + 64, cols);
+				uint64_t word = 0;
+				for (int j = c0; j < c1; j++) {
+					word |= (uint64_t) (src[j] == 0) << (j - c0);
+				}
+				word_at(i, w) = word;
+			}
+		}
+	}
+
+	inline bool empty () const {
+		return words.empty();
+	}
+
+	inline size_t word_index (int row, int w) const {
+		if (layout == TILED) {
+			return (size_t) w * rows + row;
+		}
+		return (size_t) row * words_per_row + w;
+	}
+
+	inline uint64_t& word_at (int row, int w) {
+		return words[word_index(row, w)];
+	}
+
+	inline uint64_t word_at (int row, int w) const {
+		return words[word_index(row, w)];
+	}
+
+	inline bool test (int row, int col) const {
+		return (word_at(row, col >> 6) >> (col & 63)) & 1;
+	}
+
+	inline void set (int row, int col) {
+		word_at(row, col >> 6) |= (uint64_t) 1 << (col & 63);
+	}
+
+	inline void clear (int row, int col) {
+		word_at(row, col >> 6) &= ~((uint64_t) 1 << (col & 63));
+	}
+
+	// Unpacks the columns [c0, c1) back to a CV_8U 0/1 grid, walls as 0.
+	inline Mat to_grid (int c0, int c1) const {
+		Mat grid(rows, c1 - c0, CV_8U);
+		for (int i = 0; i < rows; i++) {
+			uchar* dst = grid.ptr<uchar>(i);
+			for (int j = c0; j < c1; j++) {
+				dst[j - c0] = test(i, j) ? 0 : 1;
+			}
+		}
+		return grid;
+	}
+
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * constrained.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef CONSTRAINED_CPP
+#define CONSTRAINED_CPP
+
+#include "opencv2/opencv.hpp"
+#include "astar.cpp"
+#include "pipeline.cpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Forbids the nonzero pixels of `mask` (CV_8U, the size of the map): no
+ * path of astar_search or parallel_astar_search enters them, not even in
+ * the middle of a longer move. An empty mask lifts the restriction.
+ */
+inline void forbid (Map& map, const Mat& mask, RasterLayout layout) {
+	if (mask.empty()) {
+		map.blocked = BitGrid();
+		return;
+	}
+	Mat allowed = mask == 0;
+	map.blocked = BitGrid(allowed, layout);
+}
+
+// Options of constrained_search besides those of the search itself.
+struct Constraints {
+
+	int margin;          // pixels the window of a segment extends past its ends
+	size_t expansions;   // out: expansions of all the segments
+
+	Constraints () : margin(32), expansions(0) {}
+
+};
+
+/*
+ * Searches the cheapest path through `waypoints` in the given order (at
+ * least a start and a goal) with the A* solver. The query is split at the
+ * waypoints and the segments are searched in parallel, up to
+ * options.search_threads at a time, each in a state covering only the box
+ * of its two ends plus `constraints.margin`, so the cost follows the
+ * length of the segments rather than the size of the map. A segment that
+ * finds no path in its box is searched again over the whole map.
+ *
+ * A segment whose ends are not a whole number of steps apart is searched
+ * with unit moves, since the fixed step could not land on its goal; the
+ * adaptive stride takes unit moves near every goal already. The
+ * vertical term is measured from the first end of every segment. Returns
+ * the path as reconstruct_path gives it, empty if a waypoint is blocked or
+ * a segment has no path.
+ */
+inline vector<Map::Node> constrained_search (const Map& map, const vector<Map::Node>& waypoints, const SearchOptions& options,
+											 Constraints& constraints) {
+
+	typedef Map::Node Node;
+	constraints.expansions = 0;
+	if (waypoints.size() < 2) {
+		return vector<Node>();
+	}
+	for (Node waypoint : waypoints) {
+		int row, col;
+		tie (row, col) = waypoint;
+		if (!map.in_bounds(waypoint) or (!map.blocked.empty() and map.blocked.test(row, col))) {
+			return vector<Node>();
+		}
+	}
+
+	int segments = (int) waypoints.size() - 1;
+	vector<vector<Node>> pieces(segments);
+	vector<size_t> expansions(segments, 0);
+	atomic<int> next(0);
+	Rect whole(0, 0, map.walls.cols, map.walls.rows);
+
+	auto work = [&] () {
+		for (int k = next++; k < segments; k = next++) {
+			Node from = waypoints[k], to = waypoints[k + 1];
+			int r0, c0, r1, c1;
+			tie (r0, c0) = from;
+			tie (r1, c1) = to;
+
+			int step = options.step;
+			if ((r1 - r0) % step != 0 or (c1 - c0) % step != 0) {
+				step = 1;
+			}
+
+			int m = constraints.margin;
+			Rect box = Rect(min(c0, c1) - m, min(r0, r1) - m, abs(c1 - c0) + 2*m + 1, abs(r1 - r0) + 2*m + 1) & whole;
+			for (Rect window : {box, whole}) {
+				SearchState state(window, options.layout);
+				expansions[k] += astar_search(map, from, to, state, options.weights, step, options.mfactor);
+				pieces[k] = reconstruct_path(map, from, to, state);
+				if (!pieces[k].empty() or window.area() == whole.area()) {
+					break;
+				}
+			}
+		}
+	};
+
+	int threads = max(1, min(options.search_threads, segments));
+	if (threads == 1) {
+		work();
+	} else {
+		vector<thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.push_back(thread(work));
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	vector<Node> path;
+	for (int k = 0; k < segments; k++) {
+		constraints.expansions += expansions[k];
+		if (pieces[k].empty()) {
+			return vector<Node>();
+		}
+		path.insert(path.end(), pieces[k].begin() + (path.empty() ? 0 : 1), pieces[k].end());
+	}
+	return path;
+}
+
+#endif
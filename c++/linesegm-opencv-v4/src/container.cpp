@@ -0,0 +1,406 @@
+/*
+ * container.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef CONTAINER_CPP
+#define CONTAINER_CPP
+
+#include "opencv2/opencv.hpp"
+#include "astar.cpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * The outputs of a batch in a single file, instead of one file per line:
+ *
+ *   ContainerHeader                        16 bytes
+ *   records, appended one after the other  ContainerRecord (120 bytes) + payload
+ *   ContainerEntry[entries]                the index, 128 bytes each
+ *   ContainerFooter                        16 bytes
+ *
+ * A line image is stored encoded (as its name's extension), a path as
+ * int32 (row, col) pairs in page coordinates. Appending to an existing
+ * container drops its index and footer, which are written again on close.
+ * If a batch dies before that, the records are still found by scanning
+ * them, so both the reader and the next writer recover everything that
+ * was written in full.
+ */
+const char CONTAINER_MAGIC[4] = {'L', 'S', 'B', 'C'};
+const char CONTAINER_RECORD_MAGIC[4] = {'L', 'R', 'E', 'C'};
+const char CONTAINER_FOOTER_MAGIC[4] = {'L', 'I', 'D', 'X'};
+const uint32_t CONTAINER_VERSION = 1;
+
+enum ContainerKind { LINE_IMAGE = 1, LINE_PATH = 2 };
+
+struct ContainerHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t reserved[2];
+};
+
+struct ContainerRecord {
+	char magic[4];
+	int32_t kind;
+	int64_t length;         // of the payload that follows
+	int32_t box[4];         // x, y, width, height on the page
+	char name[88];
+};
+
+struct ContainerEntry {
+	int64_t offset;         // of the payload
+	int64_t length;
+	int32_t kind;
+	int32_t box[4];
+	int32_t reserved;
+	char name[88];          // e.g. <page>/line_<n>.jpg, zero terminated
+};
+
+struct ContainerFooter {
+	int64_t index_offset;
+	int32_t entries;
+	char magic[4];
+};
+
+inline ContainerEntry container_entry (const ContainerRecord& record, int64_t offset) {
+	ContainerEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.offset = offset;
+	entry.length = record.length;
+	entry.kind = record.kind;
+	memcpy(entry.box, record.box, sizeof(entry.box));
+	strncpy(entry.name, record.name, sizeof(entry.name) - 1);
+	return entry;
+}
+
+/*
+ * Index of the records of a container held in `data`, either read from its
+ * footer or rebuilt by walking the records. `end` is set past the last
+ * complete record. Returns false if `data` is not a container.
+ */
+inline bool read_container_index (const char* data, size_t length, vector<ContainerEntry>& index, size_t& end) {
+
+	index.clear();
+	ContainerHeader header;
+	if (length < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, CONTAINER_MAGIC, 4) != 0 or header.version != CONTAINER_VERSION) {
+		return false;
+	}
+
+	ContainerFooter footer;
+	if (length >= sizeof(header) + sizeof(footer)) {
+		memcpy(&footer, data + length - sizeof(footer), sizeof(footer));
+		size_t index_bytes = (size_t) max(footer.entries, 0) * sizeof(ContainerEntry);
+		if (memcmp(footer.magic, CONTAINER_FOOTER_MAGIC, 4) == 0 and footer.index_offset >= (int64_t) sizeof(header)
+				and (size_t) footer.index_offset + index_bytes + sizeof(footer) == length) {
+			index.resize(footer.entries);
+			memcpy(index.data(), data + footer.index_offset, index_bytes);
+			bool valid = true;
+			for (const ContainerEntry& entry : index) {
+				valid = valid and entry.offset >= (int64_t) sizeof(header) and entry.length >= 0
+						and entry.length <= footer.index_offset - entry.offset;
+			}
+			if (valid) {
+				end = (size_t) footer.index_offset;
+				return true;
+			}
+			index.clear();
+		}
+	}
+
+	// No valid footer or index: the batch was interrupted, keep the records written in full.
+	size_t offset = sizeof(header);
+	ContainerRecord record;
+	while (offset + sizeof(record) <= length) {
+		memcpy(&record, data + offset, sizeof(record));
+		if (memcmp(record.magic, CONTAINER_RECORD_MAGIC, 4) != 0 or record.length < 0
+				or (size_t) record.length > length - offset - sizeof(record)) {
+			break;
+		}
+		index.push_back(container_entry(record, (int64_t) (offset + sizeof(record))));
+		offset += sizeof(record) + (size_t) record.length;
+	}
+	end = offset;
+	return true;
+}
+
+/*
+ * Appends records to a container. Appends may come from several threads;
+ * every record is written whole under a lock.
+ */
+class BatchWriter {
+
+	FILE* file;
+	string path;
+	vector<ContainerEntry> index;
+	int64_t offset;
+	mutex lock;
+
+public:
+
+	BatchWriter () : file(nullptr), offset(0) {}
+
+	BatchWriter (const BatchWriter&) = delete;
+	BatchWriter& operator= (const BatchWriter&) = delete;
+
+	~BatchWriter () {
+		close();
+	}
+
+	// Creates the container, or reopens it to append to the records it has.
+	inline bool open (string container) {
+		close();
+		path = container;
+		index.clear();
+
+		size_t end = 0;
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd >= 0) {
+			struct stat st;
+			bool valid = false;
+			if (fstat(fd, &st) != 0) {
+				st.st_size = 0;
+			}
+			if (st.st_size > 0) {
+				void* mapping = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapping != MAP_FAILED) {
+					valid = read_container_index((const char*) mapping, (size_t) st.st_size, index, end);
+					munmap(mapping, (size_t) st.st_size);
+				}
+			}
+			::close(fd);
+			if (!valid and st.st_size > 0) {
+				cout << "\tERROR! " << path << " is not a container" << endl;
+				return false;
+			}
+		}
+
+		if (end > 0) {
+			if (truncate(path.c_str(), (off_t) end) != 0) {
+				return false;
+			}
+			file = fopen(path.c_str(), "r+b");
+			if (file) {
+				fseeko(file, (off_t) end, SEEK_SET);
+			}
+		} else {
+			file = fopen(path.c_str(), "wb");
+			if (file) {
+				ContainerHeader header;
+				memset(&header, 0, sizeof(header));
+				memcpy(header.magic, CONTAINER_MAGIC, 4);
+				header.version = CONTAINER_VERSION;
+				fwrite(&header, sizeof(header), 1, file);
+				end = sizeof(header);
+			}
+		}
+		offset = (int64_t) end;
+		return file != nullptr;
+	}
+
+	inline bool is_open () const {
+		return file != nullptr;
+	}
+
+	// Names must fit the index with their terminating zero; longer ones are rejected rather than cut.
+	inline bool append (string name, ContainerKind kind, Rect box, const void* data, size_t length) {
+		ContainerRecord record;
+		if (name.empty() or name.size() >= sizeof(record.name)) {
+			cout << "\tERROR! " << name << " does not fit the " << sizeof(record.name) - 1 << " bytes of a container name" << endl;
+			return false;
+		}
+		memset(&record, 0, sizeof(record));
+		memcpy(record.magic, CONTAINER_RECORD_MAGIC, 4);
+		record.kind = kind;
+		record.length = (int64_t) length;
+		record.box[0] = box.x;
+		record.box[1] = box.y;
+		record.box[2] = box.width;
+		record.box[3] = box.height;
+		memcpy(record.name, name.c_str(), name.size());
+
+		lock_guard<mutex> guard(lock);
+		if (!file) {
+			return false;
+		}
+		if (fwrite(&record, sizeof(record), 1, file) != 1 or (length > 0 and fwrite(data, 1, length, file) != length)) {
+			fseeko(file, (off_t) offset, SEEK_SET);  // the next record overwrites the partial one
+			return false;
+		}
+		index.push_back(container_entry(record, offset + (int64_t) sizeof(record)));
+		offset += (int64_t) (sizeof(record) + length);
+		return true;
+	}
+
+	// Encodes `image` as the extension of `name` says, e.g. <page>/line_3.jpg.
+	inline bool append_image (string name, const Mat& image, Rect box) {
+		vector<uchar> encoded;
+		size_t dot = name.rfind('.');
+		if (dot == string::npos or !imencode(name.substr(dot), image, encoded)) {
+			return false;
+		}
+		return append(name, LINE_IMAGE, box, encoded.data(), encoded.size());
+	}
+
+	inline bool append_path (string name, const vector<Map::Node>& path) {
+		vector<int32_t> nodes;
+		nodes.reserve(2 * path.size());
+		int r0 = INT32_MAX, c0 = INT32_MAX, r1 = -1, c1 = -1;
+		for (auto node : path) {
+			int row, col;
+			tie (row, col) = node;
+			nodes.push_back(row);
+			nodes.push_back(col);
+			r0 = min(r0, row);
+			c0 = min(c0, col);
+			r1 = max(r1, row);
+			c1 = max(c1, col);
+		}
+		Rect box = path.empty() ? Rect() : Rect(c0, r0, c1 - c0 + 1, r1 - r0 + 1);
+		return append(name, LINE_PATH, box, nodes.data(), nodes.size() * sizeof(int32_t));
+	}
+
+	// Writes the index and the footer. Returns false if anything could not be written.
+	inline bool close () {
+		lock_guard<mutex> guard(lock);
+		if (!file) {
+			return true;
+		}
+		ContainerFooter footer;
+		memset(&footer, 0, sizeof(footer));
+		footer.index_offset = offset;
+		footer.entries = (int32_t) index.size();
+		memcpy(footer.magic, CONTAINER_FOOTER_MAGIC, 4);
+		bool written = (index.empty() or fwrite(index.data(), sizeof(ContainerEntry), index.size(), file) == index.size())
+				and fwrite(&footer, sizeof(footer), 1, file) == 1;
+		written = fclose(file) == 0 and written;
+		file = nullptr;
+		return written;
+	}
+
+};
+
+/*
+ * Random access to the records of a container mapped in memory. The
+ * payloads are read straight from the mapping; only decoding an image or a
+ * path copies it.
+ */
+class BatchReader {
+
+	void* mapping;
+	size_t length;
+	vector<ContainerEntry> index;
+
+public:
+
+	BatchReader () : mapping(nullptr), length(0) {}
+
+	BatchReader (const BatchReader&) = delete;
+	BatchReader& operator= (const BatchReader&) = delete;
+
+	~BatchReader () {
+		close();
+	}
+
+	inline bool open (string path) {
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0 or st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		length = (size_t) st.st_size;
+		mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (mapping == MAP_FAILED) {
+			mapping = nullptr;
+			return false;
+		}
+		size_t end;
+		if (!read_container_index((const char*) mapping, length, index, end)) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	inline void close () {
+		index.clear();
+		if (mapping) {
+			munmap(mapping, length);
+			mapping = nullptr;
+		}
+		length = 0;
+	}
+
+	inline size_t size () const {
+		return index.size();
+	}
+
+	inline const ContainerEntry& entry (size_t k) const {
+		return index[k];
+	}
+
+	inline string name (size_t k) const {
+		return string(index[k].name, strnlen(index[k].name, sizeof(index[k].name)));
+	}
+
+	// Payload of record k, valid while the reader is open.
+	inline const uchar* data (size_t k) const {
+		return (const uchar*) mapping + index[k].offset;
+	}
+
+	// Index of the record named `name`, or -1. Linear, for occasional lookups.
+	inline long find (string name) const {
+		for (size_t k = 0; k < index.size(); k++) {
+			if (strncmp(index[k].name, name.c_str(), sizeof(index[k].name)) == 0) {
+				return (long) k;
+			}
+		}
+		return -1;
+	}
+
+	inline Mat image (size_t k, int flags = 0) const {
+		if (index[k].kind != LINE_IMAGE) {
+			return Mat();
+		}
+		Mat encoded(1, (int) index[k].length, CV_8U, (void*) data(k));
+		return imdecode(encoded, flags);
+	}
+
+	inline vector<Map::Node> path (size_t k) const {
+		vector<Map::Node> path;
+		if (index[k].kind != LINE_PATH) {
+			return path;
+		}
+		// Payloads are not aligned, so the nodes are copied out rather than cast.
+		vector<int32_t> nodes((size_t) index[k].length / sizeof(int32_t));
+		memcpy(nodes.data(), data(k), nodes.size() * sizeof(int32_t));
+		for (size_t i = 0; i + 1 < nodes.size(); i += 2) {
+			path.push_back(Map::Node(nodes[i], nodes[i + 1]));
+		}
+		return path;
+	}
+
+};
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * deskew.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef DESKEW_CPP
+#define DESKEW_CPP
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Sum of the squared bins of the row projection of the ink, sheared by
+ * `slope` rows per column (the projection variance up to a constant, since
+ * the total is fixed). `ink` holds the ink rows of every column. The shear
+ * is applied incrementally: all pixels of a column share the same offset.
+ */
+inline double sheared_projection_energy (const vector<vector<int>>& ink, int rows, double slope) {
+	int cols = (int) ink.size();
+	int pad = (int) ceil(fabs(slope) * cols) + 1;
+	vector<int> hist(rows + 2 * pad, 0);
+	for (int j = 0; j < cols; j++) {
+		int shift = pad - (int) lround(j * slope);
+		for (int r : ink[j]) {
+			hist[r + shift]++;
+		}
+	}
+	double energy = 0;
+	for (int h : hist) {
+		energy += (double) h * h;
+	}
+	return energy;
+}
+
+/*
+ * Estimates the skew of the text lines in degrees, positive when the lines
+ * descend to the right. The page is decimated to about 1024 pixels wide and
+ * the angle maximizing the sheared projection energy is searched over
+ * [-max_angle, max_angle], first in steps of 0.5 degrees and then refined
+ * in steps of 0.05 degrees around the best one.
+ */
+inline double estimate_skew (const Mat& im, double max_angle = 5.0) {
+
+	int factor = max(1, im.cols / 1024);
+	Mat small;
+	resize(im, small, Size(max(im.cols / factor, 1), max(im.rows / factor, 1)), 0, 0, INTER_AREA);
+
+	vector<vector<int>> ink(small.cols);
+	for (int i = 0; i < small.rows; i++) {
+		const uchar* p = small.ptr<uchar>(i);
+		for (int j = 0; j < small.cols; j++) {
+			if (p[j] < 128) {
+				ink[j].push_back(i);
+			}
+		}
+	}
+
+	double best = 0, best_energy = -1;
+	for (double angle = -max_angle; angle <= max_angle + 1e-9; angle += 0.5) {
+		double energy = sheared_projection_energy(ink, small.rows, tan(angle * CV_PI / 180));
+		if (energy > best_energy) {
+			best_energy = energy;
+			best = angle;
+		}
+	}
+
+	double coarse = best;
+	for (double angle = coarse - 0.5; angle <= coarse + 0.5 + 1e-9; angle += 0.05) {
+		double energy = sheared_projection_energy(ink, small.rows, tan(angle * CV_PI / 180));
+		if (energy > best_energy) {
+			best_energy = energy;
+			best = angle;
+		}
+	}
+
+	return best;
+}
+
+// Rotates the page by `angle` degrees about its centre, filling with white.
+inline Mat deskew (const Mat& im, double angle) {
+	Mat rotation = getRotationMatrix2D(Point2f(im.cols / 2.0f, im.rows / 2.0f), angle, 1.0);
+	Mat output;
+	warpAffine(im, output, rotation, Size(im.cols, im.rows), INTER_NEAREST, BORDER_CONSTANT, Scalar(255));
+	return output;
+}
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * evaluation.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef EVALUATION_CPP
+#define EVALUATION_CPP
+
+#include "opencv2/opencv.hpp"
+#include "utils.cpp"
+#include "gtstore.cpp"
+#include "linemask.cpp"
+#include "assignment.cpp"
+#include "asyncio.cpp"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Writes the text lines of a region into `labels` (CV_16U, page sized): the
+ * ink pixels of every line get its number, counted from `n_lines` + 1 on.
+ * A line holds the pixels strictly between the path above and the path
+ * below it, where a path node at column c bounds columns c and c + 1, as in
+ * segment_above_boundary and segment_below_boundary. `grid` is the 0/1 image
+ * of the whole page; the paths are in region coordinates.
+ */
+template<typename Node>
+inline void label_region_lines (const Mat& grid, Rect area, const vector<vector<Node>>& paths, Mat& labels, int& n_lines) {
+
+	int cols = area.width;
+	int n_paths = (int) paths.size();
+	vector<vector<int>> top, bottom;
+	path_bounds(paths, cols, top, bottom);
+
+	for (int k = 0; k <= n_paths; k++) {
+		ushort label = (ushort) (n_lines + k + 1);
+		for (int c = 0; c < cols; c++) {
+			int upper = k > 0 ? bottom[k - 1][c] : -1;
+			int lower = k < n_paths ? min(top[k][c], area.height) : area.height;
+			for (int i = upper + 1; i < lower; i++) {
+				if (grid.at<uchar>(area.y + i, area.x + c) == 0) {
+					labels.at<ushort>(area.y + i, area.x + c) = label;
+				}
+			}
+		}
+	}
+
+	n_lines += n_paths + 1;
+}
+
+/*
+ * Ink pixel counts of every groundtruth line (G), every detected line (L),
+ * indexed from 1 as the label maps, and of the pairs sharing ink (I). The
+ * pairs are stored sparsely, by groundtruth line: the pairs of line g are
+ * [row_start[g], row_start[g + 1]), each a detected line and its count.
+ */
+struct LineOverlaps {
+
+	int gt_lines;
+	int det_lines;
+	vector<long> gt_pixels;
+	vector<long> det_pixels;
+	vector<int> row_start;
+	vector<int> det;
+	vector<long> shared;
+
+	LineOverlaps (int gt_lines, int det_lines) : gt_lines(gt_lines), det_lines(det_lines), gt_pixels(gt_lines + 1, 0),
+			det_pixels(det_lines + 1, 0), row_start(gt_lines + 2, 0) {}
+
+	// Shared pixels of groundtruth line g and detected line l, 0 if they are not a stored pair.
+	inline long at (int g, int l) const {
+		for (int k = row_start[g]; k < row_start[g + 1]; k++) {
+			if (det[k] == l) {
+				return shared[k];
+			}
+		}
+		return 0;
+	}
+
+	// I / (G + L - I)
+	inline double hitrate (int g, int l) const {
+		long united = gt_pixels[g] + det_pixels[l] - at(g, l);
+		return united > 0 ? (double) at(g, l) / united : 0;
+	}
+
+	// I / G
+	inline double detection_gt (int g, int l) const {
+		return gt_pixels[g] > 0 ? (double) at(g, l) / gt_pixels[g] : 0;
+	}
+
+	// I / L
+	inline double detection_r (int g, int l) const {
+		return det_pixels[l] > 0 ? (double) at(g, l) / det_pixels[l] : 0;
+	}
+
+};
+
+/*
+ * Counts the overlaps between the groundtruth and the detected line masks.
+ * Only the pairs whose row extents intersect are looked at: the detected
+ * lines are sorted by top row, and for every groundtruth line the
+ * candidates are found by binary search, given the tallest detected line.
+ * With lines overlapping only their neighbours this is near linear in the
+ * number of lines. Pairs without shared ink are not stored.
+ */
+inline LineOverlaps compute_overlaps (const vector<LineMask>& gt, const vector<LineMask>& det) {
+
+	LineOverlaps overlaps((int) gt.size(), (int) det.size());
+	for (unsigned int g = 0; g < gt.size(); g++) {
+		overlaps.gt_pixels[g + 1] = gt[g].pixels;
+	}
+
+	vector<int> order;
+	int tallest = 0;
+	for (unsigned int l = 0; l < det.size(); l++) {
+		overlaps.det_pixels[l + 1] = det[l].pixels;
+		if (det[l].pixels > 0) {
+			order.push_back(l);
+			tallest = max(tallest, det[l].box.height);
+		}
+	}
+	sort(order.begin(), order.end(), [&det] (int a, int b) { return det[a].box.y < det[b].box.y; });
+
+	for (unsigned int g = 0; g < gt.size(); g++) {
+		overlaps.row_start[g + 1] = (int) overlaps.det.size();
+		if (gt[g].pixels == 0) {
+			continue;
+		}
+		int y0 = gt[g].box.y, y1 = gt[g].box.y + gt[g].box.height;
+		auto first = lower_bound(order.begin(), order.end(), y0 - tallest + 1,
+								 [&det] (int l, int y) { return det[l].box.y < y; });
+		for (auto itr = first; itr != order.end() and det[*itr].box.y < y1; itr++) {
+			if (det[*itr].box.y + det[*itr].box.height <= y0) {
+				continue;
+			}
+			long count = overlap_count(gt[g], det[*itr]);
+			if (count > 0) {
+				overlaps.det.push_back(*itr + 1);
+				overlaps.shared.push_back(count);
+			}
+		}
+	}
+	overlaps.row_start[gt.size() + 1] = (int) overlaps.det.size();
+	return overlaps;
+}
+
+// Masks of the groundtruth lines, bounded by the boxes of the store index.
+inline vector<LineMask> groundtruth_masks (const GroundtruthStore& store) {
+	vector<Rect> boxes;
+	for (int k = 0; k < store.header.lines; k++) {
+		boxes.push_back(Rect(store.lines[k].x, store.lines[k].y, store.lines[k].width, store.lines[k].height));
+	}
+	return masks_from_labels(store.labels, boxes);
+}
+
+// Page averages, one row of stats.csv.
+struct PageStats {
+	string page;
+	double hitrate;
+	double detection_gt;
+	double detection_r;
+	int correctly_detected;
+	int lines;
+};
+
+// Strips data/<dataset>/images/ and .jpg from an image path.
+inline string page_name (string filename, string dataset) {
+	string rem1 = "data/" + dataset + "/images/";
+	string rem2 = ".jpg";
+	string repl = "";
+	strreplace(filename, rem1, repl);
+	strreplace(filename, rem2, repl);
+	return filename;
+}
+
+/*
+ * Scores the segmentation of a page from the overlaps between its
+ * groundtruth lines and the detected ones. Every groundtruth line is paired
+ * with at most one detected line and the other way round, maximizing the
+ * total hit rate (optimal_assignment); an unpaired line scores 0. The
+ * details go to `log`.
+ */
+inline PageStats evaluate_page (string page, const vector<string>& groundtruth, const LineOverlaps& overlaps, ostream& log) {
+
+	vector<int> row_start(overlaps.row_start.begin() + 1, overlaps.row_start.end());
+	vector<int> cols;
+	vector<double> benefit;
+	for (int g = 1; g <= overlaps.gt_lines; g++) {
+		for (int k = overlaps.row_start[g]; k < overlaps.row_start[g + 1]; k++) {
+			cols.push_back(overlaps.det[k] - 1);
+			benefit.push_back(overlaps.hitrate(g, overlaps.det[k]));
+		}
+	}
+	vector<int> match = optimal_assignment(overlaps.gt_lines, overlaps.det_lines, row_start, cols, benefit);
+
+	int tot_correctly_detected = 0;
+	double tot_hitrate = 0, tot_line_detection_GT = 0, tot_line_detection_R = 0;
+	for (unsigned int i = 0; i < groundtruth.size(); i++) {
+
+		double hit_rate = 0, line_det_GT = 0, line_det_R = 0;
+		log << "\t## Groundtruth: " << groundtruth[i];
+		if (match[i] >= 0) {
+			int l = match[i] + 1;
+			hit_rate = overlaps.hitrate(i + 1, l);
+			line_det_GT = overlaps.detection_gt(i + 1, l);
+			line_det_R = overlaps.detection_r(i + 1, l);
+			log << " - Detected: line_" << l << ".jpg";
+		} else {
+			log << " - Detected: none";
+		}
+		log << " - Hit rate: " << to_string(hit_rate);
+		log << " - Line detection GT: " << to_string(line_det_GT);
+		log << " - Line detection R: " << to_string(line_det_R) << endl;
+
+		tot_hitrate = tot_hitrate + hit_rate;
+		tot_line_detection_GT = tot_line_detection_GT + line_det_GT;
+		tot_line_detection_R = tot_line_detection_R + line_det_R;
+
+		if (line_det_GT >= 0.9 && line_det_R >= 0.9) {
+			tot_correctly_detected++;
+		}
+
+	}
+
+	PageStats page_stats;
+	page_stats.page = page;
+	page_stats.hitrate = tot_hitrate / groundtruth.size();
+	page_stats.detection_gt = tot_line_detection_GT / groundtruth.size();
+	page_stats.detection_r = tot_line_detection_R / groundtruth.size();
+	page_stats.correctly_detected = tot_correctly_detected;
+	page_stats.lines = (int) groundtruth.size();
+
+	log << "\n\t## Avg. stats ==> ";
+	log << " Hit rate: " << to_string(page_stats.hitrate);
+	log << " - Line detection GT: " << to_string(page_stats.detection_gt);
+	log << " - Line detection R: " << to_string(page_stats.detection_r);
+	log << " - Correctly detected: " << to_string(tot_correctly_detected) << "/" << to_string(groundtruth.size()) << endl;
+
+	return page_stats;
+}
+
+// Appends rows to data/<dataset>/stats.csv, through `io` if given.
+inline void append_stats (string dataset, const vector<PageStats>& rows, AsyncIo* io = nullptr) {
+
+	ostringstream csvfile;
+	for (const PageStats& row : rows) {
+		csvfile << row.page;
+		csvfile << ",";
+		csvfile << int(round(row.hitrate * 100));
+		csvfile << ",";
+		csvfile << int(round(row.detection_gt * 100));
+		csvfile << ",";
+		csvfile << int(round(row.detection_r * 100));
+		csvfile << ",";
+		csvfile << row.correctly_detected;
+		csvfile << ",";
+		csvfile << row.lines;
+		csvfile << "\n";
+	}
+
+	string path = "data/" + dataset + "/stats.csv";
+	string text = csvfile.str();
+	if (io) {
+		io->write(path, vector<uchar>(text.begin(), text.end()), true);
+	} else {
+		ofstream file(path.c_str(), std::ios_base::app);
+		file << text;
+	}
+
+}
+
+/*
+ * Evaluates the line masks of a page of size `size` against
+ * data/<dataset>/groundtruth/<page>/, decoded once into the store next to
+ * it (the store of `scale` for a decimated page), and appends its row to
+ * the stats.csv file (through `io` if given).
+ */
+inline void compute_statistics (string filename, const vector<LineMask>& lines, Size size, AsyncIo* io = nullptr, double scale = 1) {
+
+	string dataset = infer_dataset(filename);
+	string page = page_name(filename, dataset);
+
+	GroundtruthStore store;
+	if (!load_groundtruth("data/" + dataset + "/groundtruth/" + page + "/", size, store, scale)) {
+		return;
+	}
+	LineOverlaps overlaps = compute_overlaps(groundtruth_masks(store), lines);
+	vector<PageStats> rows{evaluate_page(page, store.names(), overlaps, cout)};
+	append_stats(dataset, rows, io);
+
+}
+
+#endif
@@ -0,0 +1,297 @@
+/*
+ * gtstore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef GTSTORE_CPP
+#define GTSTORE_CPP
+
+#include "opencv2/opencv.hpp"
+#include "utils.cpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Decodes the groundtruth of a page once: every image of `folder` holds the
+ * ink of one line on a page sized canvas, and its ink pixels (below 128)
+ * get the line number in the returned CV_16U label map. Where two lines
+ * overlap the later one wins. Returns an empty Mat if an image does not
+ * match `size`.
+ */
+inline Mat read_groundtruth_labels (string folder, Size size, vector<string>& names) {
+
+	names = read_folder(folder.c_str());
+	sort(names.begin(), names.end());
+
+	Mat labels = Mat::zeros(size, CV_16U);
+	for (unsigned int k = 0; k < names.size(); k++) {
+		Mat ground = imread(folder + names[k], 0);
+		if (ground.size() != size) {
+			cout << "\tERROR! " << names[k] << " is " << ground.cols << "x" << ground.rows;
+			cout << ", the page is " << size.width << "x" << size.height << endl;
+			return Mat();
+		}
+		for (int i = 0; i < size.height; i++) {
+			const uchar* g = ground.ptr<uchar>(i);
+			ushort* l = labels.ptr<ushort>(i);
+			for (int j = 0; j < size.width; j++) {
+				if (g[j] < 128) {
+					l[j] = (ushort) (k + 1);
+				}
+			}
+		}
+	}
+	return labels;
+}
+
+/*
+ * Preprocessed groundtruth of one page, stored as <folder>.gtl next to the
+ * folder of line images it is built from:
+ *
+ *   GroundtruthHeader                      32 bytes
+ *   GroundtruthLine[lines]                 88 bytes each
+ *   uint16 label map, rows x cols          0 outside the lines, k for line k
+ */
+const char GTSTORE_MAGIC[4] = {'L', 'S', 'G', 'T'};
+const uint32_t GTSTORE_VERSION = 1;
+
+struct GroundtruthHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t rows;
+	int32_t cols;
+	int32_t lines;
+	int32_t reserved[3];
+};
+
+struct GroundtruthLine {
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+	int64_t pixels;
+	char name[64];
+};
+
+/*
+ * Read-only view of a store mapped in memory. `labels` points into the
+ * mapping, so it must not be written to and is only valid while the store
+ * is open.
+ */
+struct GroundtruthStore {
+
+	void* mapping;
+	size_t length;
+	GroundtruthHeader header;
+	const GroundtruthLine* lines;
+	Mat labels;
+
+	GroundtruthStore () : mapping(nullptr), length(0), lines(nullptr) {}
+
+	GroundtruthStore (const GroundtruthStore&) = delete;
+	GroundtruthStore& operator= (const GroundtruthStore&) = delete;
+
+	~GroundtruthStore () {
+		close();
+	}
+
+	inline bool open (string path) {
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0 or (size_t) st.st_size < sizeof(GroundtruthHeader)) {
+			::close(fd);
+			return false;
+		}
+		length = (size_t) st.st_size;
+		mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (mapping == MAP_FAILED) {
+			mapping = nullptr;
+			return false;
+		}
+
+		memcpy(&header, mapping, sizeof(header));
+		size_t expected = sizeof(GroundtruthHeader) + (size_t) header.lines * sizeof(GroundtruthLine)
+				+ (size_t) header.rows * header.cols * sizeof(ushort);
+		if (memcmp(header.magic, GTSTORE_MAGIC, 4) != 0 or header.version != GTSTORE_VERSION or length != expected) {
+			close();
+			return false;
+		}
+
+		const char* base = (const char*) mapping;
+		lines = (const GroundtruthLine*) (base + sizeof(GroundtruthHeader));
+		void* data = (void*) (base + sizeof(GroundtruthHeader) + (size_t) header.lines * sizeof(GroundtruthLine));
+		labels = Mat(header.rows, header.cols, CV_16U, data);
+		return true;
+	}
+
+	inline void close () {
+		labels = Mat();
+		lines = nullptr;
+		if (mapping) {
+			munmap(mapping, length);
+			mapping = nullptr;
+		}
+		length = 0;
+	}
+
+	inline vector<string> names () const {
+		vector<string> names;
+		for (int k = 0; k < header.lines; k++) {
+			names.push_back(string(lines[k].name, strnlen(lines[k].name, sizeof(lines[k].name))));
+		}
+		return names;
+	}
+
+};
+
+// Writes a label map with `names.size()` lines and its index as a store.
+inline bool write_groundtruth_store (string path, const Mat& labels, const vector<string>& names) {
+
+	int n = (int) names.size();
+	vector<GroundtruthLine> index(n);
+	vector<int> x1(n, -1), y1(n, -1);
+	for (int k = 0; k < n; k++) {
+		memset(&index[k], 0, sizeof(GroundtruthLine));
+		strncpy(index[k].name, names[k].c_str(), sizeof(index[k].name) - 1);
+		index[k].x = labels.cols;
+		index[k].y = labels.rows;
+	}
+	for (int i = 0; i < labels.rows; i++) {
+		const ushort* l = labels.ptr<ushort>(i);
+		for (int j = 0; j < labels.cols; j++) {
+			if (l[j] == 0 or l[j] > n) {
+				continue;
+			}
+			int k = l[j] - 1;
+			index[k].pixels++;
+			index[k].x = min(index[k].x, j);
+			index[k].y = min(index[k].y, i);
+			x1[k] = max(x1[k], j);
+			y1[k] = max(y1[k], i);
+		}
+	}
+	for (int k = 0; k < n; k++) {
+		if (index[k].pixels == 0) {
+			index[k].x = index[k].y = 0;
+		} else {
+			index[k].width = x1[k] - index[k].x + 1;
+			index[k].height = y1[k] - index[k].y + 1;
+		}
+	}
+
+	GroundtruthHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, GTSTORE_MAGIC, 4);
+	header.version = GTSTORE_VERSION;
+	header.rows = labels.rows;
+	header.cols = labels.cols;
+	header.lines = n;
+
+	// Written under a temporary name and renamed, so readers never map a partial file.
+	string tmp = path + ".tmp";
+	ofstream file(tmp.c_str(), ios::binary);
+	file.write((const char*) &header, sizeof(header));
+	file.write((const char*) index.data(), (streamsize) (index.size() * sizeof(GroundtruthLine)));
+	for (int i = 0; i < labels.rows; i++) {
+		file.write((const char*) labels.ptr<ushort>(i), (streamsize) (labels.cols * sizeof(ushort)));
+	}
+	file.close();
+	if (!file or rename(tmp.c_str(), path.c_str()) != 0) {
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+inline double modification_time (const struct stat& st) {
+	return (double) st.st_mtim.tv_sec + 1e-9 * st.st_mtim.tv_nsec;
+}
+
+// Newest modification time of `folder` and of its files: a line image edited in place leaves the folder's own alone.
+inline double newest_modification (string folder, const struct stat& st_folder) {
+	double newest = modification_time(st_folder);
+	for (const string& name : read_folder(folder.c_str())) {
+		struct stat st;
+		if (stat((folder + "/" + name).c_str(), &st) == 0) {
+			newest = max(newest, modification_time(st));
+		}
+	}
+	return newest;
+}
+
+// Store of the line folder `base` for pages at `scale` of their resolution: <base>.gtl, or <base>@<scale>.gtl.
+inline string groundtruth_store_path (string base, double scale = 1) {
+	if (scale == 1) {
+		return base + ".gtl";
+	}
+	ostringstream path;
+	path << base << "@" << scale << ".gtl";
+	return path.str();
+}
+
+/*
+ * Opens the groundtruth of a page from its store, building the store from
+ * the line images of `folder` first if it is missing, older than the
+ * folder or any file in it, or of a different size than the page. The
+ * stores of decimated pages (`scale` below 1) come from bin/gtraster
+ * --scale and are only opened.
+ */
+inline bool load_groundtruth (string folder, Size size, GroundtruthStore& store, double scale = 1) {
+
+	string base = folder;
+	if (!base.empty() and base[base.size() - 1] == '/') {
+		base.erase(base.size() - 1);
+	}
+	string path = groundtruth_store_path(base, scale);
+
+	if (scale != 1) {
+		if (store.open(path) and store.labels.size() == size) {
+			return true;
+		}
+		store.close();
+		cout << "\tERROR! no groundtruth " << path << " of the decimated page, see bin/gtraster --scale" << endl;
+		return false;
+	}
+
+	struct stat st_folder, st_store;
+	bool has_folder = stat(base.c_str(), &st_folder) == 0;
+	bool fresh = stat(path.c_str(), &st_store) == 0
+			and (!has_folder or modification_time(st_store) >= newest_modification(base, st_folder));
+	if (fresh and store.open(path) and store.labels.size() == size) {
+		return true;
+	}
+	if (!has_folder) {
+		cout << "\tERROR! no groundtruth in " << folder << endl;
+		return false;
+	}
+
+	vector<string> names;
+	Mat labels = read_groundtruth_labels(folder, size, names);
+	if (labels.empty() or names.empty()) {
+		return false;
+	}
+	if (!write_groundtruth_store(path, labels, names)) {
+		cout << "\tERROR! could not write " << path << endl;
+		return false;
+	}
+	return store.open(path);
+}
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * hda.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HDA_CPP
+#define HDA_CPP
+
+#include "opencv2/opencv.hpp"
+#include "astar.cpp"
+#include "workerpool.cpp"
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Lock-free multi-producer single-consumer queue (Vyukov). Producers swap
+ * themselves in at the head; the consumer owns the tail. A push that has
+ * swapped the head but not linked its cell yet is simply not visible, so
+ * pop() may report empty while a push is in flight.
+ */
+template<typename T>
+class MpscQueue {
+
+	struct Cell {
+		atomic<Cell*> next;
+		T value;
+		Cell () : next(nullptr) {}
+	};
+
+	atomic<Cell*> head;
+	Cell* tail;
+
+public:
+
+	MpscQueue () {
+		Cell* stub = new Cell();
+		head.store(stub);
+		tail = stub;
+	}
+
+	~MpscQueue () {
+		T value;
+		while (pop(value)) {}
+		delete tail;
+	}
+
+	inline void push (T value) {
+		Cell* cell = new Cell();
+		cell->value = move(value);
+		Cell* prev = head.exchange(cell, memory_order_acq_rel);
+		prev->next.store(cell, memory_order_release);
+	}
+
+	inline bool pop (T& value) {
+		Cell* next = tail->next.load(memory_order_acquire);
+		if (!next) {
+			return false;
+		}
+		value = move(next->value);
+		delete tail;
+		tail = next;
+		return true;
+	}
+
+	// Whether the consumer would find nothing to pop, a push in flight aside.
+	inline bool empty () const {
+		return tail->next.load(memory_order_acquire) == nullptr;
+	}
+
+};
+
+// A candidate g-score for a node, sent to the thread that owns the node.
+struct Relaxation {
+	int row;
+	int col;
+	float g;
+	uchar code;  // SearchState parent code, REACHED included
+};
+
+/*
+ * Hash-distributed A* (HDA*) for a single start/goal query. Every node is
+ * owned by one thread, chosen by hashing its 8x8 block, and only the owner
+ * touches its entry of the shared SearchState and keeps it in its open list.
+ * Successors owned by other threads are sent in batches through their MPSC
+ * inbox. The first path to reach the goal sets an incumbent cost; threads
+ * stop expanding nodes whose f-score is not below it.
+ *
+ * Termination: `outstanding` counts the batches sent but not yet processed.
+ * A thread with no work left marks itself idle and waits on its condition
+ * variable until a batch arrives in its inbox or the search is over. It
+ * becomes active again only by receiving a batch, and it bumps `epoch`
+ * before it decrements `outstanding`. The search is over when the epoch is
+ * unchanged across reading idle == threads and outstanding == 0; the last
+ * thread to go idle sees it and wakes the others.
+ *
+ * The threads come from `pool` if it has enough of them, so a region can
+ * keep one pool for all of its lines. With an admissible heuristic the cost
+ * of the path equals the one found by astar_search. Free run skipping is
+ * not used here, since a macro-move writes nodes owned by other threads.
+ * Returns the number of expansions.
+ */
+template<typename Graph>
+inline size_t parallel_astar_search (const Graph& graph, typename Graph::Node start, typename Graph::Node goal,
+							  SearchState& state, const CostWeights& weights, int step, int mfactor, int threads,
+							  WorkerPool* pool = nullptr) {
+
+	typedef typename Graph::Node Node;
+	if (threads <= 1) {
+		return astar_search(graph, start, goal, state, weights, step, mfactor);
+	}
+
+	state.reset();
+
+	vector<unique_ptr<MpscQueue<vector<Relaxation>>>> inbox;
+	for (int t = 0; t < threads; t++) {
+		inbox.push_back(unique_ptr<MpscQueue<vector<Relaxation>>>(new MpscQueue<vector<Relaxation>>()));
+	}
+	atomic<long> outstanding(0), epoch(0);
+	atomic<int> idle(0);
+	atomic<bool> done(false);
+	atomic<double> incumbent(numeric_limits<double>::infinity());
+	vector<vector<size_t>> touched(threads);
+	vector<size_t> expansions(threads, 0);
+	mutex parking;
+	unique_ptr<condition_variable[]> wake(new condition_variable[threads]);
+
+	// A push is followed by taking the parking lock, so a receiver cannot check its inbox and then miss the wake up.
+	auto send = [&] (int t, vector<Relaxation>& batch) {
+		outstanding++;
+		inbox[t]->push(move(batch));
+		batch = vector<Relaxation>();
+		{
+			lock_guard<mutex> guard(parking);
+		}
+		wake[t].notify_one();
+	};
+
+	auto owner = [threads] (int row, int col) -> int {
+		uint64_t h = (uint64_t) (row >> 3) * 0x9E3779B97F4A7C15ULL ^ (uint64_t) (col >> 3) * 0xC2B2AE3D27D4EB4FULL;
+		return (int) ((h >> 32) % (uint64_t) threads);
+	};
+
+	auto relax = [&] (int me, PriorityQueue<Node>& open, const Relaxation& r) {
+		size_t i = state.index(r.row, r.col);
+		uchar& code = state.parents.data[i];
+		if ((code & SearchState::REACHED) and state.gscore.data[i] <= r.g) {
+			return;
+		}
+		if (!(code & SearchState::REACHED)) {
+			touched[me].push_back(i);
+		}
+		code = r.code;
+		state.gscore.data[i] = r.g;
+
+		Node node(r.row, r.col);
+		if (node == goal) {
+			double best = incumbent.load();
+			while (r.g < best and !incumbent.compare_exchange_weak(best, (double) r.g)) {}
+			return;
+		}
+		open.put(node, r.g + heuristic(node, goal, mfactor));
+	};
+
+	auto work = [&] (int me) {
+
+		PriorityQueue<Node> open;
+		vector<vector<Relaxation>> outbox(threads);
+		bool is_idle = false;
+		int row, col, dr, dc;
+
+		auto flush = [&] () {
+			for (int t = 0; t < threads; t++) {
+				if (!outbox[t].empty()) {
+					send(t, outbox[t]);
+				}
+			}
+		};
+
+		tie (row, col) = start;
+		if (owner(row, col) == me) {
+			relax(me, open, Relaxation{row, col, 0, (uchar) SearchState::REACHED});
+		}
+
+		while (not done) {
+
+			vector<Relaxation> batch;
+			while (inbox[me]->pop(batch)) {
+				if (is_idle) {
+					epoch++;
+					idle--;
+					is_idle = false;
+				}
+				for (const Relaxation& r : batch) {
+					relax(me, open, r);
+				}
+				outstanding--;
+			}
+
+			int budget = 64;
+			while (!open.empty() and open.top_priority() < incumbent.load() and budget > 0) {
+
+				double priority;
+				Node current = open.get(priority);
+				tie (row, col) = current;
+				float gcurrent = state.gscore.data[state.index(row, col)];
+				if (priority > gcurrent + heuristic(current, goal, mfactor)) {
+					continue;
+				}
+
+				expansions[me]++;
+				budget--;
+
+				int stride = graph.stride(current, goal, step);
+				int stride_log = __builtin_ctz(stride);
+				double scale = graph.clearance > 0 ? stride : 1;
+
+				for (int d = 0; d < 8; d++) {
+					tie (dr, dc) = graph.directions[d];
+					Node neighbor(row + stride*dr, col + stride*dc);
+					if (!graph.in_bounds(neighbor) or !state.contains(row + stride*dr, col + stride*dc)
+							or graph.move_blocked(row, col, dr, dc, stride)) {
+						continue;
+					}
+					double new_gscore = gcurrent + scale * compute_cost(graph, current, neighbor, start, weights);
+					Relaxation r{row + stride*dr, col + stride*dc, (float) new_gscore,
+								 (uchar) (SearchState::REACHED | (stride_log << SearchState::STRIDE_SHIFT) | d)};
+					int o = owner(r.row, r.col);
+					if (o == me) {
+						relax(me, open, r);
+					} else {
+						outbox[o].push_back(r);
+					}
+				}
+			}
+
+			// Yield after a full budget, so that nodes are rarely expanded before their best g-score arrives.
+			flush();
+			if (budget < 64) {
+				this_thread::yield();
+				continue;
+			}
+
+			if (!is_idle) {
+				is_idle = true;
+				idle++;
+			}
+			long e1 = epoch.load();
+			if (idle.load() == threads and outstanding.load() == 0 and epoch.load() == e1) {
+				lock_guard<mutex> guard(parking);
+				done = true;
+				for (int t = 0; t < threads; t++) {
+					wake[t].notify_one();
+				}
+			} else {
+				unique_lock<mutex> guard(parking);
+				wake[me].wait(guard, [&] () { return done.load() or !inbox[me]->empty(); });
+			}
+		}
+	};
+
+	unique_ptr<WorkerPool> own;
+	if (!pool or pool->size() < threads) {
+		own.reset(new WorkerPool(threads));
+		pool = own.get();
+	}
+	pool->run(threads, work);
+	size_t total = 0;
+	for (int t = 0; t < threads; t++) {
+		state.touched.insert(state.touched.end(), touched[t].begin(), touched[t].end());
+		total += expansions[t];
+	}
+	return total;
+}
+
+#endif
@@ -0,0 +1,544 @@
+/*
+ * incremental.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef INCREMENTAL_CPP
+#define INCREMENTAL_CPP
+
+#include "opencv2/opencv.hpp"
+#include "utils.cpp"
+#include "astar.cpp"
+#include "pipeline.cpp"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+
+// A correction made by an annotator to a region, in region coordinates.
+struct SearchEdit {
+
+	enum Kind { WAYPOINT, INK, ERASE };
+
+	Kind kind;
+	int line;     // WAYPOINT: index of the line (in the seed order) that must pass through `point`
+	Point point;  // WAYPOINT: x is the column, y the row
+	Rect rect;    // INK paints an obstacle over it, ERASE clears the ink in it
+
+	static inline SearchEdit waypoint (int line, Point point) {
+		SearchEdit edit;
+		edit.kind = WAYPOINT;
+		edit.line = line;
+		edit.point = point;
+		return edit;
+	}
+
+	static inline SearchEdit paint (Rect rect, bool ink = true) {
+		SearchEdit edit;
+		edit.kind = ink ? INK : ERASE;
+		edit.line = -1;
+		edit.rect = rect;
+		return edit;
+	}
+
+};
+
+/*
+ * Lifelong Planning A* between two fixed nodes inside a window of the map,
+ * with unit moves in the 8 directions and the cost of compute_cost. The
+ * g-scores and the one step lookaheads (rhs) are kept between searches, so
+ * after the cost of some nodes changes only the part of the search they
+ * affect is redone. The heuristic factor is capped at 9 times the neighbor
+ * weight, below the cheapest move per pixel, to keep it consistent.
+ */
+class LpaSearch {
+
+	typedef Map::Node Node;
+	typedef pair<double, double> Key;
+
+	Node start;
+	Node goal;
+	Rect window;
+	double hfactor;
+	Raster<float> g;
+	Raster<float> rhs;
+	PriorityQueue<Node, Key> open;
+
+	inline bool contains (int row, int col) const {
+		return window.y <= row and row < window.y + window.height and window.x <= col and col < window.x + window.width;
+	}
+
+	inline float& g_at (Node node) {
+		return g.at(get<0>(node) - window.y, get<1>(node) - window.x);
+	}
+
+	inline float& rhs_at (Node node) {
+		return rhs.at(get<0>(node) - window.y, get<1>(node) - window.x);
+	}
+
+	inline Key key (Node node) {
+		double k = min(g_at(node), rhs_at(node));
+		return Key(k + hfactor * heuristic(node, goal, 1), k);
+	}
+
+	inline void update_vertex (const Map& map, Node node, const CostWeights& weights) {
+		int row, col, dr, dc;
+		tie (row, col) = node;
+		// Blocked nodes keep an infinite lookahead, so no path goes through them.
+		bool blocked = !map.blocked.empty() and map.blocked.test(row, col);
+		if (node != start) {
+			float best = numeric_limits<float>::infinity();
+			for (auto dir : map.directions) {
+				tie (dr, dc) = dir;
+				Node pred(row + dr, col + dc);
+				if (!blocked and map.in_bounds(pred) and contains(row + dr, col + dc) and g_at(pred) < best) {
+					best = min(best, (float) (g_at(pred) + compute_cost(map, pred, node, start, weights)));
+				}
+			}
+			rhs_at(node) = best;
+		}
+		if (g_at(node) != rhs_at(node)) {
+			open.put(node, key(node));
+		}
+	}
+
+public:
+
+	LpaSearch () : hfactor(0) {}
+
+	LpaSearch (Node start, Node goal, Rect window, int mfactor, const CostWeights& weights, RasterLayout layout) :
+			start(start), goal(goal), window(window), hfactor(min((double) mfactor, 9 * weights.neighbor)),
+			g(window.height, window.width, layout, numeric_limits<float>::infinity()),
+			rhs(window.height, window.width, layout, numeric_limits<float>::infinity()) {
+		rhs_at(start) = 0;
+		open.put(start, key(start));
+	}
+
+	inline Node from () const {
+		return start;
+	}
+
+	inline Node to () const {
+		return goal;
+	}
+
+	inline Rect area () const {
+		return window;
+	}
+
+	// The cost of the moves into `node` changed.
+	inline void invalidate (const Map& map, Node node, const CostWeights& weights) {
+		if (contains(get<0>(node), get<1>(node))) {
+			update_vertex(map, node, weights);
+		}
+	}
+
+	// Brings the g-scores up to date as far as the goal needs. Returns the expansions.
+	inline size_t compute (const Map& map, const CostWeights& weights) {
+		int row, col, dr, dc;
+		size_t expansions = 0;
+		while (!open.empty() and (open.top_priority() < key(goal) or rhs_at(goal) != g_at(goal))) {
+			Key k;
+			Node current = open.get(k);
+			// Skip the entries left behind when the key of a node changed.
+			if (g_at(current) == rhs_at(current) or k != key(current)) {
+				continue;
+			}
+			expansions++;
+			tie (row, col) = current;
+			if (g_at(current) > rhs_at(current)) {
+				g_at(current) = rhs_at(current);
+			} else {
+				g_at(current) = numeric_limits<float>::infinity();
+				update_vertex(map, current, weights);
+			}
+			for (auto dir : map.directions) {
+				tie (dr, dc) = dir;
+				Node next(row + dr, col + dc);
+				if (map.in_bounds(next) and contains(row + dr, col + dc)) {
+					update_vertex(map, next, weights);
+				}
+			}
+		}
+		return expansions;
+	}
+
+	// Walks back from the goal along the cheapest predecessors; empty if the goal is unreachable.
+	inline vector<Node> path (const Map& map, const CostWeights& weights) {
+		vector<Node> path;
+		if (g_at(goal) == numeric_limits<float>::infinity()) {
+			return path;
+		}
+		int row, col, dr, dc;
+		Node current = goal;
+		path.push_back(current);
+		while (current != start and path.size() <= (size_t) window.area()) {
+			tie (row, col) = current;
+			Node best = current;
+			double best_cost = numeric_limits<double>::infinity();
+			for (auto dir : map.directions) {
+				tie (dr, dc) = dir;
+				Node pred(row + dr, col + dc);
+				if (!map.in_bounds(pred) or !contains(row + dr, col + dc)) {
+					continue;
+				}
+				double cost = g_at(pred) + compute_cost(map, pred, current, start, weights);
+				if (cost < best_cost) {
+					best_cost = cost;
+					best = pred;
+				}
+			}
+			if (best == current) {
+				return vector<Node>();
+			}
+			current = best;
+			path.push_back(current);
+		}
+		reverse(path.begin(), path.end());
+		return path;
+	}
+
+};
+
+/*
+ * Separating paths of a region that can be corrected in place. Every line
+ * is split at its waypoints into segments, each an LpaSearch over the rows
+ * of the line (the corridor of the options, or the rows between the seeds
+ * of its neighbors) and the columns between its two ends. A waypoint only
+ * replaces the segment it falls in; painting changes the map under the
+ * rectangle and the distances in its columns, and only the nodes whose cost
+ * changed are handed to the segments that contain them.
+ *
+ * The moves are unit moves and the vertical term is measured from the start
+ * of every segment, so the paths can differ slightly from those of
+ * search_region with a larger step.
+ */
+class IncrementalRegion {
+
+	typedef Map::Node Node;
+
+	Map map;
+	vector<int> lines;
+	vector<Rect> windows;
+	vector<vector<LpaSearch>> segments;
+	vector<vector<Node>> current;
+	CostWeights weights;
+	int mfactor;
+	RasterLayout layout;
+	size_t total_expansions;
+
+	inline int end_column () const {
+		return (map.walls.cols - 1) % 2 == 0 ? map.walls.cols - 1 : map.walls.cols - 2;
+	}
+
+	inline void solve (int line) {
+		current[line].clear();
+		for (LpaSearch& segment : segments[line]) {
+			total_expansions += segment.compute(map, weights);
+			vector<Node> piece = segment.path(map, weights);
+			if (piece.empty()) {
+				current[line].clear();
+				return;
+			}
+			current[line].insert(current[line].end(), piece.begin() + (current[line].empty() ? 0 : 1), piece.end());
+		}
+	}
+
+	inline LpaSearch segment (int line, Node from, Node to) {
+		Rect window = windows[line];
+		window.x = get<1>(from);
+		window.width = get<1>(to) - get<1>(from) + 1;
+		return LpaSearch(from, to, window, mfactor, weights, layout);
+	}
+
+	inline bool add_waypoint (int line, Point point) {
+		int row = min(max(point.y, 0), map.walls.rows - 1), col = point.x;
+		if (line < 0 or line >= (int) lines.size() or col <= 0 or col >= end_column()) {
+			return false;
+		}
+		Rect& window = windows[line];
+		int top = min(window.y, row), bottom = max(window.y + window.height, row + 1);
+		window.y = top;
+		window.height = bottom - top;
+
+		vector<LpaSearch>& pieces = segments[line];
+		for (unsigned int k = 0; k < pieces.size(); k++) {
+			Node from = pieces[k].from(), to = pieces[k].to();
+			if (col < get<1>(from) or col > get<1>(to)) {
+				continue;
+			}
+			// A waypoint on the column of another one moves it.
+			if (col == get<1>(from) or col == get<1>(to)) {
+				unsigned int moved = col == get<1>(from) ? k : k + 1;
+				Node before = pieces[moved - 1].from(), after = pieces[moved].to();
+				pieces[moved - 1] = segment(line, before, Node(row, col));
+				pieces[moved] = segment(line, Node(row, col), after);
+			} else {
+				pieces[k] = segment(line, from, Node(row, col));
+				pieces.insert(pieces.begin() + k + 1, segment(line, Node(row, col), to));
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// Paints `rect` and returns the nodes whose cost changed.
+	inline vector<Node> paint (Rect rect, bool ink) {
+		vector<Node> changed;
+		rect &= Rect(0, 0, map.walls.cols, map.walls.rows);
+		if (rect.width <= 0 or rect.height <= 0) {
+			return changed;
+		}
+		for (int i = rect.y; i < rect.y + rect.height; i++) {
+			for (int j = rect.x; j < rect.x + rect.width; j++) {
+				if (ink) {
+					map.walls.set(i, j);
+				} else {
+					map.walls.clear(i, j);
+				}
+			}
+		}
+
+		// The distances run along the columns, so only those under the rectangle change.
+		Mat dmat = distance_transform(map.walls.to_grid(rect.x, rect.x + rect.width));
+		float table[2][256];
+		cost_table(weights, table);
+		for (int i = 0; i < map.walls.rows; i++) {
+			for (int j = rect.x; j < rect.x + rect.width; j++) {
+				uchar d = dmat.at<uchar>(i, j - rect.x);
+				bool painted = rect.contains(Point(j, i));
+				if (d == map.distances.at(i, j) and !painted) {
+					continue;
+				}
+				map.distances.at(i, j) = d;
+				if (!map.costs.empty()) {
+					map.costs.at(i, j) = table[map.walls.test(i, j)][d];
+				}
+				changed.push_back(Node(i, j));
+			}
+		}
+		return changed;
+	}
+
+public:
+
+	/*
+	 * Takes over the map of a prepared region and searches every line once.
+	 * Free run skipping and adaptive strides are dropped from the map, since
+	 * LPA* needs the same moves out of a node in every search.
+	 */
+	IncrementalRegion (const PreparedRegion& prepared, const SearchOptions& options) : map(prepared.map), lines(prepared.lines),
+			weights(options.weights), mfactor(options.mfactor), layout(options.layout), total_expansions(0) {
+
+		map.free_runs = Raster<ushort>();
+		map.clearance = 0;
+		int corridor = prepared.corridor > 0 ? prepared.corridor : options.corridor;
+		int end = end_column();
+
+		for (unsigned int k = 0; k < lines.size(); k++) {
+			int top, bottom;
+			if (corridor > 0) {
+				top = max(lines[k] - corridor, 0);
+				bottom = min(lines[k] + corridor + 1, map.walls.rows);
+			} else {
+				top = k > 0 ? lines[k - 1] : 0;
+				bottom = k + 1 < lines.size() ? lines[k + 1] + 1 : map.walls.rows;
+			}
+			windows.push_back(Rect(0, top, map.walls.cols, bottom - top));
+			segments.push_back(vector<LpaSearch>());
+			segments.back().push_back(segment(k, Node(lines[k], 0), Node(lines[k], end)));
+		}
+
+		current.resize(lines.size());
+		for (unsigned int k = 0; k < lines.size(); k++) {
+			solve(k);
+		}
+	}
+
+	// One path per line in region coordinates, empty where no path was found.
+	inline const vector<vector<Node>>& paths () const {
+		return current;
+	}
+
+	inline size_t expansions () const {
+		return total_expansions;
+	}
+
+	/*
+	 * Applies the edits in order and repairs the lines they touch. Edits that
+	 * fall outside the region or name an unknown line are ignored. Returns
+	 * the updated paths of all lines.
+	 */
+	inline const vector<vector<Node>>& apply (const vector<SearchEdit>& edits) {
+		vector<bool> dirty(lines.size(), false);
+		for (const SearchEdit& edit : edits) {
+			if (edit.kind == SearchEdit::WAYPOINT) {
+				if (add_waypoint(edit.line, edit.point)) {
+					dirty[edit.line] = true;
+				}
+				continue;
+			}
+			vector<Node> changed = paint(edit.rect, edit.kind == SearchEdit::INK);
+			for (unsigned int k = 0; k < lines.size(); k++) {
+				for (LpaSearch& segment : segments[k]) {
+					Rect area = segment.area();
+					for (Node node : changed) {
+						if (area.contains(Point(get<1>(node), get<0>(node)))) {
+							segment.invalidate(map, node, weights);
+							dirty[k] = true;
+						}
+					}
+				}
+			}
+		}
+		for (unsigned int k = 0; k < lines.size(); k++) {
+			if (dirty[k]) {
+				solve(k);
+			}
+		}
+		return current;
+	}
+
+	/*
+	 * Searches every segment again from scratch with astar_search, unit moves
+	 * and the capped heuristic factor of LpaSearch, on the map as edited so
+	 * far. Returns the lines whose repaired path costs more (or less) than
+	 * the fresh one, or was found where it was not, or the other way round.
+	 */
+	inline vector<int> check () {
+		vector<int> wrong;
+		int factor = (int) min((double) mfactor, 9 * weights.neighbor);
+		for (unsigned int k = 0; k < lines.size(); k++) {
+			bool same = true;
+			for (LpaSearch& segment : segments[k]) {
+				Node from = segment.from(), to = segment.to();
+				SearchState state(segment.area(), layout);
+				astar_search(map, from, to, state, weights, 1, factor);
+				size_t i = state.index(get<0>(to), get<1>(to));
+				double fresh = state.reached(i) ? state.gscore.data[i] : numeric_limits<double>::infinity();
+
+				vector<Node> piece = segment.path(map, weights);
+				double repaired = piece.empty() ? numeric_limits<double>::infinity() : 0;
+				for (unsigned int n = 1; n < piece.size(); n++) {
+					repaired += compute_cost(map, piece[n - 1], piece[n], from, weights);
+				}
+				if (repaired != fresh and !(abs(repaired - fresh) <= 1e-4 * fresh)) {
+					same = false;
+				}
+			}
+			if (!same) {
+				wrong.push_back(k);
+			}
+		}
+		return wrong;
+	}
+
+};
+
+/*
+ * Corrections of a page, one per line of a text file in page coordinates:
+ *
+ *   waypoint <path> <x> <y>          path <path> (numbered from 1 over the
+ *                                    page, as path_<n> in a container) must
+ *                                    pass through column x, row y
+ *   ink <x> <y> <width> <height>     paints an obstacle over the rectangle
+ *   erase <x> <y> <width> <height>   clears the ink in the rectangle
+ *
+ * Empty lines and lines starting with # are skipped. The waypoints keep
+ * their page wide path number in SearchEdit::line, from 0.
+ */
+inline bool load_corrections (string path, vector<SearchEdit>& edits) {
+
+	ifstream file(path.c_str());
+	if (!file) {
+		cout << "ERROR! no corrections " << path << endl;
+		return false;
+	}
+
+	edits.clear();
+	string line;
+	while (getline(file, line)) {
+		if (line.empty() or line[0] == '#') {
+			continue;
+		}
+		stringstream fields(line);
+		string kind;
+		int a, b, c, d;
+		fields >> kind >> a >> b >> c;
+		if (fields and kind == "waypoint" and a >= 1) {
+			edits.push_back(SearchEdit::waypoint(a - 1, Point(b, c)));
+		} else if (fields >> d and (kind == "ink" or kind == "erase") and c > 0 and d > 0) {
+			edits.push_back(SearchEdit::paint(Rect(a, b, c, d), kind == "ink"));
+		} else {
+			cout << "ERROR! bad line '" << line << "' in " << path << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Segments a page as segment_page does, but through IncrementalRegion, and
+ * replays `edits` (see load_corrections) on every region they fall in. The
+ * repaired paths are checked against a fresh search of the edited map and
+ * any line that differs is reported in the log of its region.
+ */
+inline vector<RegionPaths> correct_page (Mat& im, const PageOptions& page, const SearchOptions& options,
+										 const vector<SearchEdit>& edits, ostream& log) {
+
+	vector<RegionPaths> regions;
+	int first = 0;
+	for (Rect area : page_areas(im, page, log)) {
+
+		PreparedRegion prepared = prepare_region(im, area, options);
+		ostringstream region_log;
+		IncrementalRegion corrected(prepared, options);
+		int n_lines = (int) prepared.lines.size();
+
+		vector<SearchEdit> local;
+		for (SearchEdit edit : edits) {
+			if (edit.kind == SearchEdit::WAYPOINT) {
+				if (edit.line < first or edit.line >= first + n_lines or !area.contains(edit.point)) {
+					continue;
+				}
+				edit.line -= first;
+				edit.point = Point(edit.point.x - area.x, edit.point.y - area.y);
+			} else {
+				edit.rect &= area;
+				if (edit.rect.width <= 0 or edit.rect.height <= 0) {
+					continue;
+				}
+				edit.rect.x -= area.x;
+				edit.rect.y -= area.y;
+			}
+			local.push_back(edit);
+		}
+
+		size_t before = corrected.expansions();
+		corrected.apply(local);
+		region_log << "- Corrections: " << local.size() << " edits, repaired with " << corrected.expansions() - before;
+		region_log << " expansions (" << before << " for the first search)." << endl;
+		vector<int> wrong = corrected.check();
+		for (int k : wrong) {
+			region_log << "\tWARNING! path " << first + k + 1 << " differs from a fresh search of the corrected page" << endl;
+		}
+
+		RegionPaths region;
+		region.area = area;
+		region.lines = prepared.lines;
+		region.paths = corrected.paths();
+		region.expansions = corrected.expansions();
+		region.stages = prepared.stages;
+		region.log = prepared.log + region_log.str();
+		regions.push_back(region);
+		first += n_lines;
+	}
+	return regions;
+}
+
+#endif
@@ -0,0 +1,408 @@
+/*
+ * instrumentation.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef INSTRUMENTATION_CPP
+#define INSTRUMENTATION_CPP
+
+#include "opencv2/opencv.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Bytes held by the tracked allocations: the search rasters and bit grids
+ * (TrackingAllocator) and every cv::Mat once TrackingMatAllocator is
+ * installed. Process wide totals, and per thread ones for the stage peaks:
+ * a stage is charged for what its own thread allocates, so the workers of a
+ * parallel search are not included in it.
+ */
+struct MemoryCounters {
+
+	atomic<long> current;
+	atomic<long> peak;
+
+	MemoryCounters () : current(0), peak(0) {}
+
+};
+
+inline MemoryCounters& process_memory () {
+	static MemoryCounters counters;
+	return counters;
+}
+
+struct ThreadMemory {
+	long current;
+	long peak;
+};
+
+inline ThreadMemory& thread_memory () {
+	static thread_local ThreadMemory counters = {0, 0};
+	return counters;
+}
+
+inline void track_allocation (size_t bytes) {
+	MemoryCounters& process = process_memory();
+	long now = process.current += (long) bytes;
+	long peak = process.peak.load(memory_order_relaxed);
+	while (now > peak and !process.peak.compare_exchange_weak(peak, now, memory_order_relaxed)) {}
+
+	ThreadMemory& thread = thread_memory();
+	thread.current += (long) bytes;
+	thread.peak = max(thread.peak, thread.current);
+}
+
+inline void track_release (size_t bytes) {
+	process_memory().current -= (long) bytes;
+	thread_memory().current -= (long) bytes;
+}
+
+// std::allocator that counts its bytes in the memory counters.
+template<typename T>
+struct TrackingAllocator {
+
+	typedef T value_type;
+
+	TrackingAllocator () {}
+
+	template<typename U>
+	TrackingAllocator (const TrackingAllocator<U>&) {}
+
+	inline T* allocate (size_t n) {
+		T* p = std::allocator<T>().allocate(n);
+		track_allocation(n * sizeof(T));
+		return p;
+	}
+
+	inline void deallocate (T* p, size_t n) {
+		track_release(n * sizeof(T));
+		std::allocator<T>().deallocate(p, n);
+	}
+
+};
+
+template<typename T, typename U>
+inline bool operator== (const TrackingAllocator<T>&, const TrackingAllocator<U>&) {
+	return true;
+}
+
+template<typename T, typename U>
+inline bool operator!= (const TrackingAllocator<T>&, const TrackingAllocator<U>&) {
+	return false;
+}
+
+template<typename T>
+using TrackedVector = vector<T, TrackingAllocator<T>>;
+
+/*
+ * Counts the buffers of every cv::Mat, forwarding the allocations to the
+ * standard OpenCV allocator. Buffers wrapping user memory (e.g. the mapped
+ * groundtruth stores) are not counted.
+ */
+class TrackingMatAllocator : public MatAllocator {
+
+	MatAllocator* base;
+
+public:
+
+	TrackingMatAllocator () : base(Mat::getStdAllocator()) {}
+
+	UMatData* allocate (int dims, const int* sizes, int type, void* data, size_t* step, AccessFlag flags,
+						UMatUsageFlags usage) const {
+		UMatData* u = base->allocate(dims, sizes, type, data, step, flags, usage);
+		if (u) {
+			u->currAllocator = this;
+			if (!(u->flags & UMatData::USER_ALLOCATED)) {
+				track_allocation(u->size);
+			}
+		}
+		return u;
+	}
+
+	bool allocate (UMatData* u, AccessFlag flags, UMatUsageFlags usage) const {
+		return base->allocate(u, flags, usage);
+	}
+
+	void deallocate (UMatData* u) const {
+		if (!u) {
+			return;
+		}
+		if (!(u->flags & UMatData::USER_ALLOCATED)) {
+			track_release(u->size);
+		}
+		u->currAllocator = base;
+		base->deallocate(u);
+	}
+
+};
+
+// Routes the Mat allocations of the whole process through TrackingMatAllocator.
+inline void install_memory_tracking () {
+	static TrackingMatAllocator allocator;
+	Mat::setDefaultAllocator(&allocator);
+}
+
+/*
+ * Hardware counters of the calling thread, read with perf_event_open as
+ * one group: cycles, instructions, L1 data read misses, last level cache
+ * read misses and branch misses, user space only. The group is opened once
+ * per thread when profiling is on (--perf); events the machine or the
+ * perf_event_paranoid setting do not allow are left out. Values are scaled
+ * if the kernel had to multiplex the group.
+ */
+enum PerfEvent { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES, PERF_EVENTS };
+
+struct PerfSample {
+
+	bool valid[PERF_EVENTS];
+	uint64_t value[PERF_EVENTS];
+
+	PerfSample () {
+		for (int e = 0; e < PERF_EVENTS; e++) {
+			valid[e] = false;
+			value[e] = 0;
+		}
+	}
+
+	inline PerfSample operator- (const PerfSample& start) const {
+		PerfSample delta;
+		for (int e = 0; e < PERF_EVENTS; e++) {
+			delta.valid[e] = valid[e] and start.valid[e];
+			delta.value[e] = delta.valid[e] ? value[e] - start.value[e] : 0;
+		}
+		return delta;
+	}
+
+	inline bool any () const {
+		for (int e = 0; e < PERF_EVENTS; e++) {
+			if (valid[e]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+};
+
+inline bool& perf_enabled () {
+	static bool enabled = false;
+	return enabled;
+}
+
+class PerfCounters {
+
+	int leader;
+	int fds[PERF_EVENTS];
+	int slot[PERF_EVENTS];  // position of every event in the group read, -1 if not opened
+	int opened;
+
+public:
+
+	PerfCounters () : leader(-1), opened(0) {
+		for (int e = 0; e < PERF_EVENTS; e++) {
+			fds[e] = -1;
+			slot[e] = -1;
+		}
+#ifdef __linux__
+		const uint32_t types[PERF_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+											 PERF_TYPE_HARDWARE};
+		const uint64_t configs[PERF_EVENTS] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_BRANCH_MISSES};
+
+		for (int e = 0; e < PERF_EVENTS; e++) {
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = types[e];
+			attr.config = configs[e];
+			attr.disabled = leader < 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			int fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+			if (fd < 0) {
+				continue;
+			}
+			if (leader < 0) {
+				leader = fd;
+			}
+			fds[e] = fd;
+			slot[e] = opened++;
+		}
+		if (leader >= 0) {
+			ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+#endif
+	}
+
+	PerfCounters (const PerfCounters&) = delete;
+	PerfCounters& operator= (const PerfCounters&) = delete;
+
+	~PerfCounters () {
+#ifdef __linux__
+		for (int e = 0; e < PERF_EVENTS; e++) {
+			if (fds[e] >= 0) {
+				close(fds[e]);
+			}
+		}
+#endif
+	}
+
+	inline PerfSample read_sample () const {
+		PerfSample sample;
+#ifdef __linux__
+		if (leader < 0) {
+			return sample;
+		}
+		uint64_t data[3 + PERF_EVENTS];  // nr, time enabled, time running, values
+		if (::read(leader, data, sizeof(data)) < (ssize_t) ((3 + opened) * sizeof(uint64_t))) {
+			return sample;
+		}
+		double scale = data[2] > 0 ? (double) data[1] / data[2] : 1;
+		for (int e = 0; e < PERF_EVENTS; e++) {
+			if (slot[e] >= 0) {
+				sample.valid[e] = true;
+				sample.value[e] = (uint64_t) (data[3 + slot[e]] * scale);
+			}
+		}
+#endif
+		return sample;
+	}
+
+};
+
+// Counters of the calling thread now, nothing valid unless profiling is on.
+inline PerfSample read_perf () {
+	if (!perf_enabled()) {
+		return PerfSample();
+	}
+	static thread_local PerfCounters counters;
+	return counters.read_sample();
+}
+
+// Time and peak tracked memory of one stage of the pipeline.
+struct StageStats {
+	string name;
+	double seconds;
+	size_t peak_bytes;  // above what the thread held when the stage started
+	PerfSample perf;    // counters of the stage, with --perf
+};
+
+/*
+ * Measures a stage on the calling thread, from construction to stop().
+ * Meters may be nested: an outer stage still sees the peak of an inner one.
+ */
+class StageMeter {
+
+	chrono::steady_clock::time_point start;
+	long base;
+	long saved_peak;
+	PerfSample counters;
+
+public:
+
+	StageMeter () : start(chrono::steady_clock::now()), counters(read_perf()) {
+		ThreadMemory& thread = thread_memory();
+		base = thread.current;
+		saved_peak = thread.peak;
+		thread.peak = thread.current;
+	}
+
+	// Peak so far, as stop() would report it.
+	inline size_t peak () const {
+		return (size_t) max(thread_memory().peak - base, 0L);
+	}
+
+	inline StageStats stop (string name) {
+		ThreadMemory& thread = thread_memory();
+		StageStats stats;
+		stats.name = name;
+		stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		stats.peak_bytes = (size_t) max(thread.peak - base, 0L);
+		stats.perf = read_perf() - counters;
+		thread.peak = max(thread.peak, saved_peak);
+		return stats;
+	}
+
+};
+
+inline string format_bytes (size_t bytes) {
+	char text[32];
+	snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+	return text;
+}
+
+// "1.20G cycles, IPC 1.85, L1 miss 3.40M, LLC miss 210.00K, branch miss 1.10M"
+inline string format_perf (const PerfSample& perf) {
+
+	auto count = [] (uint64_t n) {
+		char text[32];
+		if (n >= 1000000000) snprintf(text, sizeof(text), "%.2fG", n / 1e9);
+		else if (n >= 1000000) snprintf(text, sizeof(text), "%.2fM", n / 1e6);
+		else if (n >= 1000) snprintf(text, sizeof(text), "%.2fK", n / 1e3);
+		else snprintf(text, sizeof(text), "%llu", (unsigned long long) n);
+		return string(text);
+	};
+
+	vector<string> fields;
+	if (perf.valid[PERF_CYCLES]) {
+		fields.push_back(count(perf.value[PERF_CYCLES]) + " cycles");
+	}
+	if (perf.valid[PERF_CYCLES] and perf.valid[PERF_INSTRUCTIONS] and perf.value[PERF_CYCLES] > 0) {
+		char ipc[32];
+		snprintf(ipc, sizeof(ipc), "IPC %.2f", (double) perf.value[PERF_INSTRUCTIONS] / perf.value[PERF_CYCLES]);
+		fields.push_back(ipc);
+	} else if (perf.valid[PERF_INSTRUCTIONS]) {
+		fields.push_back(count(perf.value[PERF_INSTRUCTIONS]) + " instructions");
+	}
+	if (perf.valid[PERF_L1_MISSES]) {
+		fields.push_back("L1 miss " + count(perf.value[PERF_L1_MISSES]));
+	}
+	if (perf.valid[PERF_LLC_MISSES]) {
+		fields.push_back("LLC miss " + count(perf.value[PERF_LLC_MISSES]));
+	}
+	if (perf.valid[PERF_BRANCH_MISSES]) {
+		fields.push_back("branch miss " + count(perf.value[PERF_BRANCH_MISSES]));
+	}
+
+	string text;
+	for (unsigned int k = 0; k < fields.size(); k++) {
+		text += (k > 0 ? ", " : "") + fields[k];
+	}
+	return text;
+}
+
+// "(0.120 s, 35.2 MB peak)", followed by the counters with --perf.
+inline string format_stage (const StageStats& stats) {
+	char text[32];
+	snprintf(text, sizeof(text), "(%.3f s, ", stats.seconds);
+	string line = text + format_bytes(stats.peak_bytes) + " peak)";
+	if (stats.perf.any()) {
+		line += " [" + format_perf(stats.perf) + "]";
+	}
+	return line;
+}
+
+#endif
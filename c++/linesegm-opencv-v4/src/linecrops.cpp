@@ -0,0 +1,106 @@
+/*
+ * linecrops.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LINECROPS_CPP
+#define LINECROPS_CPP
+
+#include "opencv2/opencv.hpp"
+#include "utils.cpp"
+#include "pipeline.cpp"
+#include "evaluation.cpp"
+#include <algorithm>
+#include <climits>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * A text line as a window of the label map of its page: `view` is
+ * labels(box) and shares its buffer, so `view.data` and `view.step` are the
+ * offset and stride of the line in it. Only the pixels equal to `label` are
+ * ink of the line; the corners of the box can hold ink of the neighbours.
+ */
+struct LineCrop {
+
+	ushort label;
+	Rect box;      // tight box of the ink, page coordinates; empty if the line has no ink
+	long pixels;
+	Mat view;
+
+	LineCrop () : label(0), pixels(0) {}
+
+	// The line alone over its box, ink black on white as segment_text_line writes it.
+	inline Mat image () const {
+		return view != (double) label;
+	}
+
+};
+
+// The label map of a page, one label per text line, and a crop per line into it.
+struct PageLines {
+
+	Mat labels;  // CV_16U, page sized, 0 outside the lines
+	vector<LineCrop> lines;
+
+};
+
+/*
+ * Labels the lines of every region of the page as label_region_lines, in
+ * the order save_region_lines numbers them, and finds the tight box of each
+ * in a single pass over the labels. No pixel is copied per line. `grid` is
+ * the 0/1 image of the whole page.
+ */
+inline PageLines crop_page_lines (const Mat& grid, const vector<RegionPaths>& regions) {
+
+	PageLines page;
+	page.labels = Mat::zeros(grid.size(), CV_16U);
+	int n_lines = 0;
+	for (const RegionPaths& region : regions) {
+		label_region_lines(grid, region.area, region.paths, page.labels, n_lines);
+	}
+
+	vector<int> r0(n_lines + 1, INT_MAX), r1(n_lines + 1, -1), c0(n_lines + 1, INT_MAX), c1(n_lines + 1, -1);
+	vector<long> pixels(n_lines + 1, 0);
+	for (int i = 0; i < page.labels.rows; i++) {
+		const ushort* l = page.labels.ptr<ushort>(i);
+		for (int j = 0; j < page.labels.cols; j++) {
+			if (l[j]) {
+				r0[l[j]] = min(r0[l[j]], i);
+				r1[l[j]] = i;
+				c0[l[j]] = min(c0[l[j]], j);
+				c1[l[j]] = max(c1[l[j]], j);
+				pixels[l[j]]++;
+			}
+		}
+	}
+
+	for (int k = 1; k <= n_lines; k++) {
+		LineCrop line;
+		line.label = (ushort) k;
+		line.pixels = pixels[k];
+		if (pixels[k] > 0) {
+			line.box = Rect(c0[k], r0[k], c1[k] - c0[k] + 1, r1[k] - r0[k] + 1);
+			line.view = page.labels(line.box);
+		}
+		page.lines.push_back(line);
+	}
+	return page;
+}
+
+/*
+ * Saves every line as line_<n>.jpg in `out_dir` like save_region_lines, but
+ * cropped to the ink of the line instead of the full region width. A line
+ * without ink is saved as a single white pixel, so the numbering has no gaps.
+ */
+inline void save_line_crops (const PageLines& page, string out_dir, AsyncIo* io = nullptr) {
+	for (const LineCrop& line : page.lines) {
+		Mat image = line.pixels > 0 ? line.image() : Mat(1, 1, CV_8U, Scalar(255));
+		save_image(out_dir + "line_" + to_string(line.label) + ".jpg", image, io);
+	}
+}
+
+#endif
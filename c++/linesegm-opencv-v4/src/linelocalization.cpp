@@ -5,6 +5,8 @@
  *      Author: saverio
  */
 
+#ifndef LINELOCALIZATION_CPP
+#define LINELOCALIZATION_CPP
 
 #include "opencv2/opencv.hpp"
 #include "../lib/persistence1d.hpp"
@@ -45,7 +47,14 @@ inline vector<int> detect_peaks (Mat& hist, double delta) {
 	return lines;
 }
 
-inline vector<int> projection_analysis (Mat& im) {
+// Row projection of an inverted (ink = 1) image, normalized to its highest row.
+struct RowProfile {
+	Mat hist;
+	double mean;  // of the normalized rows
+	double std;
+};
+
+inline RowProfile row_profile (Mat& im) {
 
 	im.convertTo(im, CV_64F);
 	Mat hist = Mat(im.rows, 1, CV_64F);
@@ -59,24 +68,42 @@ inline vector<int> projection_analysis (Mat& im) {
 	double min, max;
 	minMaxLoc(hist, &min, &max);
 
-	hist = hist / max;
+	RowProfile profile;
+	profile.hist = hist / max;
+	profile.mean = hist_mean / max;
+	profile.std = hist_std / max;
+	return profile;
+}
 
-	double delta = (hist_mean / max) + 0.66 * (hist_std / max);  /* was: +0.6, -0.1 */
+// Peaks of persistence above mean + spread * std.
+inline vector<int> projection_peaks (const RowProfile& profile, double spread) {
+	Mat hist = profile.hist;
+	double delta = profile.mean + spread * profile.std;  /* was: +0.6, -0.1 */
 	// double epsilon = 0.015; //to compensate error in peak detection for some cases
 	return detect_peaks (hist, delta);
 }
 
-inline vector<int> localize (Mat& input) {
+inline vector<int> projection_analysis (Mat& im, double spread = 0.66) {
+	RowProfile profile = row_profile(im);
+	return projection_peaks(profile, spread);
+}
 
+// The profile localize() looks for peaks in, so that several spreads can be tried on one page.
+inline RowProfile localization_profile (Mat& input) {
 	Mat im;
 	enhance(input, im);
 	invert(im, im);
-	vector<int> peaks = projection_analysis(im);
+	return row_profile(im);
+}
+
+// Rows halfway between consecutive peaks: the seeds of the separating paths.
+inline vector<int> peak_valleys (vector<int> peaks) {
+
 	sort(peaks.begin(), peaks.end());
 
 	vector<int> lines;
 	int dist, valley;
-	for (unsigned int i = 0; i < peaks.size() - 1; i++) {
+	for (unsigned int i = 0; i + 1 < peaks.size(); i++) {
 		dist = (peaks[i + 1] - peaks[i]) / 2;
 		valley = peaks[i] + dist;
 		lines.push_back(valley);
@@ -84,3 +111,95 @@ inline vector<int> localize (Mat& input) {
 
 	return lines;
 }
+
+inline vector<int> localize (Mat& input, double spread = 0.66) {
+	RowProfile profile = localization_profile(input);
+	return peak_valleys(projection_peaks(profile, spread));
+}
+
+/*
+ * Splits a page into text columns at the gutters of its vertical projection.
+ * The valleys of the (smoothed) ink profile are found with Persistence1D; a
+ * valley is a gutter if it is deep (persistence of at least half the highest
+ * column), almost free of ink and at least `min_gutter` of the page wide.
+ * The columns are cut in the middle of every gutter.
+ */
+inline vector<Rect> detect_columns (Mat& input, double min_gutter = 0.02) {
+
+	vector<float> profile(input.cols, 0);
+	for (int i = 0; i < input.rows; i++) {
+		const uchar* p = input.ptr<uchar>(i);
+		for (int j = 0; j < input.cols; j++) {
+			if (p[j] < 128) {
+				profile[j]++;
+			}
+		}
+	}
+
+	int window = max(3, input.cols / 100);
+	vector<float> smooth(input.cols, 0);
+	float sum = 0;
+	for (int j = 0; j < input.cols + window / 2; j++) {
+		if (j < input.cols) {
+			sum += profile[j];
+		}
+		if (j - window >= 0) {
+			sum -= profile[j - window];
+		}
+		if (j - window / 2 >= 0) {
+			smooth[j - window / 2] = sum / window;
+		}
+	}
+
+	vector<Rect> columns;
+	float peak = *max_element(smooth.begin(), smooth.end());
+	if (peak <= 0) {
+		columns.push_back(Rect(0, 0, input.cols, input.rows));
+		return columns;
+	}
+	for (unsigned int j = 0; j < smooth.size(); j++) {
+		smooth[j] /= peak;
+	}
+
+	Persistence1D detector;
+	detector.RunPersistence(smooth);
+	vector<TPairedExtrema> extrema;
+	detector.GetPairedExtrema(extrema, 0.5);
+
+	vector<int> valleys;
+	for (vector<TPairedExtrema>::iterator it = extrema.begin(); it != extrema.end(); it++) {
+		valleys.push_back((*it).MinIndex);
+	}
+	valleys.push_back(detector.GetGlobalMinimumIndex());
+
+	vector<int> cuts;
+	int edge = input.cols / 10;
+	for (int valley : valleys) {
+		if (valley < edge or valley >= input.cols - edge) {
+			continue;
+		}
+		int left = valley, right = valley;
+		while (left > 0 and smooth[left - 1] <= 0.05) {
+			left--;
+		}
+		while (right < input.cols - 1 and smooth[right + 1] <= 0.05) {
+			right++;
+		}
+		if (smooth[valley] <= 0.05 and right - left + 1 >= min_gutter * input.cols) {
+			cuts.push_back((left + right) / 2);
+		}
+	}
+	sort(cuts.begin(), cuts.end());
+	cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+
+	int x = 0;
+	for (int cut : cuts) {
+		columns.push_back(Rect(x, 0, cut - x, input.rows));
+		x = cut;
+	}
+	columns.push_back(Rect(x, 0, input.cols - x, input.rows));
+
+	return columns;
+}
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * linemask.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LINEMASK_CPP
+#define LINEMASK_CPP
+
+#include "opencv2/opencv.hpp"
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include <stdint.h>
+#if defined(__AVX512VPOPCNTDQ__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Ink of one text line packed at one bit per pixel over its bounding box.
+ * Rows start at the 64 aligned page column at or before the box, so the
+ * words of two masks covering the same columns line up and can be ANDed
+ * directly.
+ */
+struct LineMask {
+
+	Rect box;           // page coordinates, empty if the line has no ink
+	int x0;             // page column of bit 0 of every row
+	int words_per_row;
+	long pixels;
+	vector<uint64_t> words;
+
+	LineMask () : x0(0), words_per_row(0), pixels(0) {}
+
+	explicit LineMask (Rect box) : box(box), x0(box.x & ~63),
+			words_per_row(box.width > 0 ? ((box.x + box.width - 1) >> 6) - (box.x >> 6) + 1 : 0), pixels(0),
+			words((size_t) box.height * words_per_row, 0) {}
+
+	inline void set (int row, int col) {
+		words[(size_t) (row - box.y) * words_per_row + ((col - x0) >> 6)] |= (uint64_t) 1 << (col & 63);
+	}
+
+	// Words of page row `row` from page column `col` (rounded down to a multiple of 64) on.
+	inline const uint64_t* row_words (int row, int col) const {
+		return words.data() + (size_t) (row - box.y) * words_per_row + ((col - x0) >> 6);
+	}
+
+};
+
+// Number of bits set in both a[0, n) and b[0, n).
+inline long popcount_and (const uint64_t* a, const uint64_t* b, int n) {
+	long count = 0;
+	int i = 0;
+#if defined(__AVX512VPOPCNTDQ__)
+	__m512i acc = _mm512_setzero_si512();
+	for (; i + 8 <= n; i += 8) {
+		__m512i x = _mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+		acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+	}
+	count = _mm512_reduce_add_epi64(acc);
+#elif defined(__AVX2__)
+	// Nibble lookup: popcount of every byte through two shuffles, summed per 64 bit lane by sad.
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+											0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	__m256i acc = _mm256_setzero_si256();
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (a + i)), _mm256_loadu_si256((const __m256i*) (b + i)));
+		__m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low)),
+										_mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+	}
+	count = _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+#endif
+	for (; i < n; i++) {
+		count += __builtin_popcountll(a[i] & b[i]);
+	}
+	return count;
+}
+
+// Ink pixels shared by two lines, counted over the intersection of their boxes only.
+inline long overlap_count (const LineMask& a, const LineMask& b) {
+	Rect both = a.box & b.box;
+	if (both.width <= 0 or both.height <= 0) {
+		return 0;
+	}
+	int n = ((both.x + both.width - 1) >> 6) - (both.x >> 6) + 1;
+	long count = 0;
+	for (int i = both.y; i < both.y + both.height; i++) {
+		count += popcount_and(a.row_words(i, both.x), b.row_words(i, both.x), n);
+	}
+	return count;
+}
+
+// Masks of the lines 1..n_lines of a CV_16U label map, `boxes` bounding each of them.
+inline vector<LineMask> masks_from_labels (const Mat& labels, const vector<Rect>& boxes) {
+	vector<LineMask> masks;
+	for (unsigned int k = 0; k < boxes.size(); k++) {
+		LineMask mask(boxes[k]);
+		ushort label = (ushort) (k + 1);
+		for (int i = mask.box.y; i < mask.box.y + mask.box.height; i++) {
+			const ushort* l = labels.ptr<ushort>(i);
+			for (int j = mask.box.x; j < mask.box.x + mask.box.width; j++) {
+				if (l[j] == label) {
+					mask.set(i, j);
+					mask.pixels++;
+				}
+			}
+		}
+		masks.push_back(move(mask));
+	}
+	return masks;
+}
+
+/*
+ * Per column rows bounded by every path of a region: the highest (top) and
+ * the lowest (bottom) row of its nodes, where a node at column c bounds
+ * columns c and c + 1 as in segment_above_boundary/segment_below_boundary.
+ */
+template<typename Node>
+inline void path_bounds (const vector<vector<Node>>& paths, int cols, vector<vector<int>>& top, vector<vector<int>>& bottom) {
+	top.assign(paths.size(), vector<int>(cols, INT_MAX));
+	bottom.assign(paths.size(), vector<int>(cols, -1));
+	for (unsigned int k = 0; k < paths.size(); k++) {
+		for (auto node : paths[k]) {
+			int row, col;
+			tie (row, col) = node;
+			for (int c = col; c <= col + 1 and c < cols; c++) {
+				top[k][c] = min(top[k][c], row);
+				bottom[k][c] = max(bottom[k][c], row);
+			}
+		}
+	}
+}
+
+/*
+ * Appends the masks of the text lines of a region, straight from its paths:
+ * line k holds the ink strictly between path k - 1 and path k. `grid` is
+ * the 0/1 image of the whole page; the paths are in region coordinates.
+ */
+template<typename Node>
+inline void mask_region_lines (const Mat& grid, Rect area, const vector<vector<Node>>& paths, vector<LineMask>& masks) {
+
+	vector<vector<int>> top, bottom;
+	path_bounds(paths, area.width, top, bottom);
+	int n_paths = (int) paths.size();
+
+	for (int k = 0; k <= n_paths; k++) {
+
+		// First pass: the bounding box of the ink of the line.
+		int r0 = INT_MAX, r1 = -1, c0 = INT_MAX, c1 = -1;
+		for (int c = 0; c < area.width; c++) {
+			int upper = k > 0 ? bottom[k - 1][c] : -1;
+			int lower = k < n_paths ? min(top[k][c], area.height) : area.height;
+			for (int i = upper + 1; i < lower; i++) {
+				if (grid.at<uchar>(area.y + i, area.x + c) == 0) {
+					r0 = min(r0, i);
+					r1 = max(r1, i);
+					c0 = min(c0, c);
+					c1 = max(c1, c);
+				}
+			}
+		}
+		if (r1 < 0) {
+			masks.push_back(LineMask());
+			continue;
+		}
+
+		LineMask mask(Rect(area.x + c0, area.y + r0, c1 - c0 + 1, r1 - r0 + 1));
+		for (int c = c0; c <= c1; c++) {
+			int upper = max(k > 0 ? bottom[k - 1][c] : -1, r0 - 1);
+			int lower = min(k < n_paths ? min(top[k][c], area.height) : area.height, r1 + 1);
+			for (int i = upper + 1; i < lower; i++) {
+				if (grid.at<uchar>(area.y + i, area.x + c) == 0) {
+					mask.set(area.y + i, area.x + c);
+					mask.pixels++;
+				}
+			}
+		}
+		masks.push_back(move(mask));
+	}
+}
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * localizationstats.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LOCALIZATIONSTATS_CPP
+#define LOCALIZATIONSTATS_CPP
+
+#include "opencv2/opencv.hpp"
+#include "utils.cpp"
+#include "linelocalization.cpp"
+#include "pipeline.cpp"
+#include "gtstore.cpp"
+#include "evaluation.cpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+
+// Localization of one page with one spread, one row of lines.csv.
+struct LocalizationStats {
+
+	string page;
+	double spread;
+	int lines;           // detected: valleys + 1 in every region
+	int expected;        // groundtruth lines with ink, -1 without groundtruth
+	int gaps;            // between consecutive groundtruth lines of a region
+	int separated;       // gaps holding exactly one valley
+	double valley_error; // mean distance in rows from a valley to the closest gap
+
+	LocalizationStats () : spread(0), lines(0), expected(-1), gaps(0), separated(0), valley_error(0) {}
+
+};
+
+/*
+ * Scores the valleys of a region (page rows) against the groundtruth lines
+ * whose box is centered in it. A gap between two consecutive lines spans
+ * their centers; its row is the middle of the white between them, or of
+ * their centers if they touch.
+ */
+inline void score_valleys (const vector<int>& valleys, Rect area, const GroundtruthStore& store, LocalizationStats& stats,
+						   double& error, int& valleys_scored) {
+
+	vector<pair<double, const GroundtruthLine*>> lines;
+	for (int k = 0; k < store.header.lines; k++) {
+		const GroundtruthLine& line = store.lines[k];
+		double cx = line.x + line.width / 2.0, cy = line.y + line.height / 2.0;
+		if (line.pixels > 0 and area.x <= cx and cx < area.x + area.width and area.y <= cy and cy < area.y + area.height) {
+			lines.push_back(make_pair(cy, &line));
+		}
+	}
+	sort(lines.begin(), lines.end());
+
+	vector<double> gap_rows;
+	for (unsigned int k = 0; k + 1 < lines.size(); k++) {
+		double top = lines[k].first, bottom = lines[k + 1].first;
+		int inside = 0;
+		for (int v : valleys) {
+			inside += top < v and v < bottom;
+		}
+		stats.gaps++;
+		stats.separated += inside == 1;
+
+		int white_top = lines[k].second->y + lines[k].second->height, white_bottom = lines[k + 1].second->y;
+		gap_rows.push_back(white_top < white_bottom ? (white_top + white_bottom) / 2.0 : (top + bottom) / 2.0);
+	}
+
+	if (gap_rows.empty()) {
+		return;
+	}
+	for (int v : valleys) {
+		double closest = fabs(v - gap_rows[0]);
+		for (double row : gap_rows) {
+			closest = min(closest, fabs(v - row));
+		}
+		error += closest;
+		valleys_scored++;
+	}
+}
+
+/*
+ * Runs only the line localization over `filenames`, `jobs` pages at a time,
+ * once per spread: the row profile of every region is computed once and
+ * only the peak detection is repeated. The line counts and valleys are
+ * compared against the line extents of the groundtruth stores, when there
+ * are any. The rows go to data/<dataset>/lines.csv, whose first two columns
+ * are those of line-localization-analysis/lines.csv, and the averages of
+ * every spread to the console.
+ */
+inline void evaluate_localization (const vector<string>& filenames, const PageOptions& page, const vector<double>& spreads, int jobs) {
+
+	vector<vector<LocalizationStats>> rows(filenames.size());
+	vector<string> logs(filenames.size());
+	atomic<size_t> next(0);
+
+	auto work = [&] () {
+		for (size_t k = next++; k < filenames.size(); k = next++) {
+
+			ostringstream log;
+			string filename = filenames[k];
+			string dataset = infer_dataset(filename);
+			string name = page_name(filename, dataset);
+
+			Mat im = imread(filename, 0);
+			if (im.empty()) {
+				logs[k] = "\tERROR! could not read " + filename + "\n";
+				continue;
+			}
+
+			vector<Rect> areas = page_areas(im, page, log);
+			vector<RowProfile> profiles;
+			for (Rect area : areas) {
+				Mat region = im(area);
+				profiles.push_back(localization_profile(region));
+			}
+
+			GroundtruthStore store;
+			bool has_groundtruth = load_groundtruth("data/" + dataset + "/groundtruth/" + name + "/", im.size(), store, page.scale);
+
+			for (double spread : spreads) {
+				LocalizationStats stats;
+				stats.page = name;
+				stats.spread = spread;
+				double error = 0;
+				int valleys_scored = 0;
+				for (unsigned int a = 0; a < areas.size(); a++) {
+					vector<int> valleys = peak_valleys(projection_peaks(profiles[a], spread));
+					stats.lines += (int) valleys.size() + 1;
+					for (int& v : valleys) {
+						v += areas[a].y;
+					}
+					if (has_groundtruth) {
+						score_valleys(valleys, areas[a], store, stats, error, valleys_scored);
+					}
+				}
+				if (has_groundtruth) {
+					stats.expected = 0;
+					for (int l = 0; l < store.header.lines; l++) {
+						stats.expected += store.lines[l].pixels > 0;
+					}
+					stats.valley_error = valleys_scored > 0 ? error / valleys_scored : 0;
+				}
+				rows[k].push_back(stats);
+			}
+			logs[k] = log.str();
+		}
+	};
+
+	vector<thread> workers;
+	for (int t = 0; t < jobs; t++) {
+		workers.push_back(thread(work));
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	map<string, ofstream> csvfiles;
+	for (size_t k = 0; k < filenames.size(); k++) {
+		cout << logs[k];
+		if (rows[k].empty()) {
+			continue;
+		}
+		string dataset = infer_dataset(filenames[k]);
+		if (!csvfiles.count(dataset)) {
+			csvfiles[dataset].open("data/" + dataset + "/lines.csv");
+			csvfiles[dataset] << "\"document_id\",\"lines\",\"expected\",\"gaps\",\"separated\",\"valley_error\",\"spread\"\n";
+		}
+		for (const LocalizationStats& row : rows[k]) {
+			csvfiles[dataset] << "\"" << row.page << "\"," << row.lines << ",";
+			csvfiles[dataset] << (row.expected >= 0 ? to_string(row.expected) : "") << "," << row.gaps << "," << row.separated << ",";
+			csvfiles[dataset] << row.valley_error << "," << row.spread << "\n";
+		}
+	}
+
+	cout << "\n## spread  pages  count MAE  exact count  separated gaps  valley error" << endl;
+	for (unsigned int s = 0; s < spreads.size(); s++) {
+		int pages = 0, exact = 0, gaps = 0, separated = 0;
+		double absolute = 0, error = 0;
+		for (auto& page_rows : rows) {
+			if (page_rows.empty() or page_rows[s].expected < 0) {
+				continue;
+			}
+			const LocalizationStats& row = page_rows[s];
+			pages++;
+			absolute += abs(row.lines - row.expected);
+			exact += row.lines == row.expected;
+			gaps += row.gaps;
+			separated += row.separated;
+			error += row.valley_error;
+		}
+		char line[128];
+		snprintf(line, sizeof(line), "   %5.2f  %5d  %9.3f  %11.3f  %14.3f  %12.2f", spreads[s], pages, pages ? absolute / pages : 0,
+				 pages ? (double) exact / pages : 0, gaps ? (double) separated / gaps : 0, pages ? error / pages : 0);
+		cout << line << endl;
+	}
+}
+
+#endif
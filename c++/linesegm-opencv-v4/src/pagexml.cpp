@@ -0,0 +1,301 @@
+/*
+ * pagexml.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef PAGEXML_CPP
+#define PAGEXML_CPP
+
+#include "opencv2/opencv.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+
+// A start, end or empty element tag. Names are stripped of their namespace prefix.
+struct XmlTag {
+
+	enum Kind { START, END, EMPTY };
+
+	Kind kind;
+	string name;
+	vector<pair<string, string>> attributes;
+
+	inline string attribute (string key) const {
+		for (auto& attribute : attributes) {
+			if (attribute.first == key) {
+				return attribute.second;
+			}
+		}
+		return "";
+	}
+
+};
+
+/*
+ * Pull parser returning the tags of an XML file one at a time, read in
+ * fixed size chunks, so a page is never held in memory as a tree. Text,
+ * comments, processing instructions and declarations are skipped; only the
+ * predefined entities are decoded in attribute values.
+ */
+class XmlStream {
+
+	FILE* file;
+	vector<char> buffer;
+	size_t pos;
+	size_t end;
+
+	inline int get () {
+		if (pos == end) {
+			end = file ? fread(buffer.data(), 1, buffer.size(), file) : 0;
+			pos = 0;
+			if (end == 0) {
+				return EOF;
+			}
+		}
+		return (unsigned char) buffer[pos++];
+	}
+
+	// Consumes everything up to and including `terminator`.
+	inline bool skip_past (const char* terminator) {
+		int n = (int) strlen(terminator), matched = 0;
+		for (int c = get(); c != EOF; c = get()) {
+			if (c == terminator[matched]) {
+				if (++matched == n) {
+					return true;
+				}
+			} else {
+				matched = c == terminator[0] ? 1 : 0;
+			}
+		}
+		return false;
+	}
+
+	static inline bool is_space (int c) {
+		return c == ' ' or c == '\t' or c == '\n' or c == '\r';
+	}
+
+	static inline bool is_name (int c) {
+		return c != EOF and !is_space(c) and c != '=' and c != '>' and c != '/' and c != '"' and c != '\'';
+	}
+
+	static inline string local_name (const string& name) {
+		size_t colon = name.find(':');
+		return colon == string::npos ? name : name.substr(colon + 1);
+	}
+
+	static inline string decode (const string& value) {
+		if (value.find('&') == string::npos) {
+			return value;
+		}
+		static const char* entities[][2] = {{"&amp;", "&"}, {"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""}, {"&apos;", "'"}};
+		string decoded;
+		for (size_t i = 0; i < value.size(); ) {
+			bool replaced = false;
+			for (auto& entity : entities) {
+				if (value.compare(i, strlen(entity[0]), entity[0]) == 0) {
+					decoded += entity[1];
+					i += strlen(entity[0]);
+					replaced = true;
+					break;
+				}
+			}
+			if (!replaced) {
+				decoded += value[i++];
+			}
+		}
+		return decoded;
+	}
+
+public:
+
+	explicit XmlStream (string path, size_t chunk = 1 << 16) : file(fopen(path.c_str(), "rb")), buffer(chunk), pos(0), end(0) {}
+
+	XmlStream (const XmlStream&) = delete;
+	XmlStream& operator= (const XmlStream&) = delete;
+
+	~XmlStream () {
+		if (file) {
+			fclose(file);
+		}
+	}
+
+	inline bool is_open () const {
+		return file != nullptr;
+	}
+
+	// Reads the next tag, false at the end of the file or on a truncated tag.
+	inline bool next (XmlTag& tag) {
+
+		int c;
+		while (true) {
+			do {
+				c = get();
+			} while (c != EOF and c != '<');
+			if (c == EOF) {
+				return false;
+			}
+
+			c = get();
+			if (c == '?') {
+				skip_past("?>");
+			} else if (c == '!') {
+				int a = get(), b = get();
+				if (a == '-' and b == '-') {
+					skip_past("-->");
+				} else if (a == '[') {
+					skip_past("]]>");
+				} else {
+					skip_past(">");
+				}
+			} else {
+				break;
+			}
+		}
+
+		tag.attributes.clear();
+		tag.kind = XmlTag::START;
+		if (c == '/') {
+			tag.kind = XmlTag::END;
+			c = get();
+		}
+
+		string name;
+		for (; is_name(c); c = get()) {
+			name += (char) c;
+		}
+		tag.name = local_name(name);
+
+		while (true) {
+			while (is_space(c)) {
+				c = get();
+			}
+			if (c == EOF) {
+				return false;
+			}
+			if (c == '>') {
+				return true;
+			}
+			if (c == '/') {
+				tag.kind = XmlTag::EMPTY;
+				c = get();
+				continue;
+			}
+
+			string key, value;
+			for (; is_name(c); c = get()) {
+				key += (char) c;
+			}
+			if (key.empty()) {
+				return false;  // stray character in the tag
+			}
+			while (is_space(c)) {
+				c = get();
+			}
+			if (c != '=') {
+				continue;  // attribute without value
+			}
+			do {
+				c = get();
+			} while (is_space(c));
+			if (c != '"' and c != '\'') {
+				return false;
+			}
+			int quote = c;
+			for (c = get(); c != quote and c != EOF; c = get()) {
+				value += (char) c;
+			}
+			tag.attributes.push_back(make_pair(local_name(key), decode(value)));
+			c = get();
+		}
+	}
+
+};
+
+// Text lines of a PAGE-XML page, with the image they belong to.
+struct PageGroundtruth {
+
+	string image;
+	int width;
+	int height;
+	vector<vector<Point>> lines;
+
+	PageGroundtruth () : width(0), height(0) {}
+
+};
+
+// "x1,y1 x2,y2 ..." as in the points attribute of a PAGE 2013+ Coords.
+inline vector<Point> parse_points (const string& points) {
+	vector<Point> polygon;
+	const char* p = points.c_str();
+	char* next;
+	while (*p) {
+		long x = strtol(p, &next, 10);
+		if (next == p or *next != ',') {
+			break;
+		}
+		p = next + 1;
+		long y = strtol(p, &next, 10);
+		if (next == p) {
+			break;
+		}
+		polygon.push_back(Point((int) x, (int) y));
+		p = next;
+		while (*p == ' ' or *p == '\t' or *p == '\n' or *p == '\r') {
+			p++;
+		}
+	}
+	return polygon;
+}
+
+/*
+ * Streams a PAGE-XML file and collects the polygon of every text line: the
+ * Coords of a TextLine, or of a TextRegion of type "textline" as in the
+ * older files of Saint Gall. Both the points attribute and the Point
+ * children of Coords are read. Returns false if the file cannot be read.
+ */
+inline bool parse_page_xml (string path, PageGroundtruth& page) {
+
+	XmlStream xml(path);
+	if (!xml.is_open()) {
+		return false;
+	}
+
+	vector<bool> in_line;  // one entry per open TextRegion or TextLine
+	bool in_coords = false;
+	XmlTag tag;
+	while (xml.next(tag)) {
+
+		bool line_scope = !in_line.empty() and in_line.back();
+
+		if (tag.name == "Page" and tag.kind != XmlTag::END) {
+			page.image = tag.attribute("imageFilename");
+			page.width = atoi(tag.attribute("imageWidth").c_str());
+			page.height = atoi(tag.attribute("imageHeight").c_str());
+		} else if (tag.name == "TextRegion" or tag.name == "TextLine") {
+			if (tag.kind == XmlTag::START) {
+				in_line.push_back(tag.name == "TextLine" or tag.attribute("type") == "textline");
+			} else if (tag.kind == XmlTag::END and !in_line.empty()) {
+				in_line.pop_back();
+			}
+		} else if (tag.name == "Coords" and line_scope) {
+			if (tag.kind == XmlTag::END) {
+				in_coords = false;
+			} else {
+				page.lines.push_back(parse_points(tag.attribute("points")));
+				in_coords = tag.kind == XmlTag::START;
+			}
+		} else if (tag.name == "Point" and in_coords and tag.kind != XmlTag::END) {
+			page.lines.back().push_back(Point(atoi(tag.attribute("x").c_str()), atoi(tag.attribute("y").c_str())));
+		}
+	}
+	return true;
+}
+
+#endif
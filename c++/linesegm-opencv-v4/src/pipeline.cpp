@@ -0,0 +1,516 @@
+/*
+ * pipeline.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef PIPELINE_CPP
+#define PIPELINE_CPP
+
+#include "opencv2/opencv.hpp"
+#include "utils.cpp"
+#include "linelocalization.cpp"
+#include "astar.cpp"
+#include "hda.cpp"
+#include "wavefront.cpp"
+#include "textarea.cpp"
+#include "deskew.cpp"
+#include "instrumentation.cpp"
+#include "asyncio.cpp"
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+
+struct SearchOptions {
+
+	string dataset;
+	CostWeights weights;     // dataset_weights(dataset) unless fixed_weights
+	bool fixed_weights;      // weights loaded from a profile, kept for every dataset
+	int step;
+	int mfactor;
+	RasterLayout layout;
+	int skip_clearance;      // 0 disables free run skipping
+	int adaptive_clearance;  // 0 keeps the fixed step
+	int search_threads;      // threads of a single line search (HDA* or DP), 1 is sequential
+	string solver;           // "astar" or "dp"
+	int corridor;            // rows searched above and below each seed, 0 searches the whole region
+	double spread;           // peak persistence threshold of localize, in standard deviations above the mean
+	size_t memory_budget;    // bytes a region may use (see prepare_region), 0 for no limit
+
+	SearchOptions () : dataset("NULL"), fixed_weights(false), step(2), mfactor(5), layout(ROW_MAJOR), skip_clearance(0),
+			adaptive_clearance(0), search_threads(1), solver("astar"), corridor(0), spread(0.66), memory_budget(0) {}
+
+};
+
+// Sets the dataset of `filename` and, unless they come from a profile, its cost weights.
+inline void select_dataset (SearchOptions& options, string filename) {
+	options.dataset = infer_dataset(filename);
+	if (!options.fixed_weights) {
+		options.weights = dataset_weights(options.dataset);
+	}
+}
+
+// Paths of one region of the page (the text area or one of its columns).
+struct RegionPaths {
+
+	typedef Map::Node Node;
+
+	Rect area;                   // region in page coordinates
+	vector<int> lines;           // seed rows, region coordinates
+	vector<vector<Node>> paths;  // region coordinates
+	size_t expansions;
+	vector<StageStats> stages;
+	string log;
+
+	RegionPaths () : expansions(0) {}
+
+};
+
+/*
+ * The 0/1 grid and the distance Mat only live while the map is built: the
+ * search reads the packed walls and the distances raster. The distance
+ * transform, the hottest part, is appended to `stages` on its own if given.
+ */
+inline Map build_map (const Mat& imbw, const SearchOptions& options, bool cost_field = true, vector<StageStats>* stages = nullptr) {
+	Map map;
+	Mat grid = imbw / 255;
+	map.walls = BitGrid(grid, options.layout);
+	StageMeter transform;
+	Mat dmat = distance_transform(grid);
+	if (stages) {
+		stages->push_back(transform.stop("distance transform"));
+	}
+	grid.release();
+	map.distances = Raster<uchar>(dmat, options.layout);
+	if (options.skip_clearance > 0) {
+		map.free_runs = compute_free_runs(dmat, options.skip_clearance, options.layout);
+	}
+	if (cost_field) {
+		map.costs = compute_cost_field(map, options.weights, options.layout);
+	}
+	map.clearance = options.adaptive_clearance;
+	return map;
+}
+
+// A region localized and mapped, ready to be searched with any step or mfactor.
+struct PreparedRegion {
+
+	Rect area;          // region in page coordinates
+	vector<int> lines;  // seed rows, region coordinates
+	Map map;
+	int corridor;       // set by the memory budget, 0 keeps the one of the options
+	vector<StageStats> stages;
+	string log;
+
+	PreparedRegion () : corridor(0) {}
+
+};
+
+/*
+ * First estimates of the tracked bytes per pixel of the stages of a region,
+ * as allocated by localize (enhanced and inverted images, the CV_64F
+ * projection input), build_map (grid, dmat, distances, walls, free runs and
+ * cost field) and a search state (g-scores and parents of every searched
+ * pixel). See memory_calibration for how they are corrected.
+ */
+const double LOCALIZATION_BYTES = 10;
+const double SEARCH_STATE_BYTES = 5;
+
+inline double map_bytes (const SearchOptions& options, bool cost_field) {
+	return 3 + 0.125 + (options.skip_clearance > 0 ? 2 : 0) + (cost_field ? 4 : 0);
+}
+
+enum MemoryStage { LOCALIZATION_STAGE, MAP_STAGE, SEARCH_STAGE, MEMORY_STAGES };
+
+/*
+ * Ratio of the tracked peak of every stage (StageMeter) to its estimate,
+ * the largest measured on the regions done so far, 1 before the first. The
+ * budget plans of later regions scale the estimates by it. Stages estimated
+ * under 1 MB are not measured, their fixed allocations would dominate.
+ */
+struct MemoryCalibration {
+
+	mutex lock;
+	double ratio[MEMORY_STAGES];
+
+	MemoryCalibration () {
+		for (int s = 0; s < MEMORY_STAGES; s++) {
+			ratio[s] = 0;
+		}
+	}
+
+	inline double factor (MemoryStage stage) {
+		lock_guard<mutex> guard(lock);
+		return ratio[stage] > 0 ? ratio[stage] : 1;
+	}
+
+	inline void measure (MemoryStage stage, size_t peak, double estimate) {
+		if (estimate < 1024 * 1024) {
+			return;
+		}
+		lock_guard<mutex> guard(lock);
+		ratio[stage] = max(ratio[stage], peak / estimate);
+	}
+
+};
+
+inline MemoryCalibration& memory_calibration () {
+	static MemoryCalibration calibration;
+	return calibration;
+}
+
+// Corridor of twice the median spacing of the seeds, the one a memory budget falls back to.
+inline int budget_corridor (const vector<int>& lines) {
+	vector<int> spacing;
+	for (unsigned int k = 0; k + 1 < lines.size(); k++) {
+		spacing.push_back(lines[k + 1] - lines[k]);
+	}
+	nth_element(spacing.begin(), spacing.begin() + spacing.size() / 2, spacing.end());
+	return max(2 * spacing[spacing.size() / 2], 1);
+}
+
+// Pixels a search state covers with a corridor of `corridor` rows, the whole region if 0.
+inline double searched_pixels (Size size, int corridor) {
+	return corridor > 0 ? min(2 * corridor + 1, size.height) * (double) size.width : (double) size.area();
+}
+
+inline vector<int> localize_decimated (const Mat& imbw, int decimation, double spread) {
+	Mat small;
+	resize(imbw, small, Size(), 1.0 / decimation, 1.0 / decimation, INTER_AREA);
+	vector<int> lines = localize(small, spread);
+	for (int& line : lines) {
+		line = min(line * decimation + decimation / 2, imbw.rows - 1);
+	}
+	return lines;
+}
+
+/*
+ * Localizes the lines of `area` and builds its search map. With a memory
+ * budget, the estimated peak of every stage is checked against it first,
+ * and lower memory modes are switched on until it fits: localization on a
+ * page decimated by 2, 4 or 8, then a corridor of twice the median line
+ * spacing around every seed, then no cost field (A* only, the DP solver
+ * reads it). The estimates are scaled by memory_calibration, and the
+ * measured peaks of the stages calibrate it in turn. Once the map is built
+ * its actual size is checked again, and the corridor and cost field are
+ * given up then if the search no longer fits.
+ */
+inline PreparedRegion prepare_region (const Mat& page, Rect area, const SearchOptions& options) {
+
+	PreparedRegion region;
+	region.area = area;
+	ostringstream log;
+	double pixels = (double) area.width * area.height, budget = (double) options.memory_budget;
+
+	MemoryCalibration& calibration = memory_calibration();
+	double localization_bytes = LOCALIZATION_BYTES * calibration.factor(LOCALIZATION_STAGE);
+	int decimation = 1;
+	while (budget > 0 and localization_bytes * pixels / (decimation * decimation) > budget and decimation < 8) {
+		decimation *= 2;
+	}
+
+	StageMeter localization;
+	Mat imbw = page(area);
+	log << "- Detecting lines location..";
+	if (decimation > 1) {
+		log << " (decimated 1/" << decimation << " for the memory budget)";
+		region.lines = localize_decimated(imbw, decimation, options.spread);
+	} else {
+		region.lines = localize(imbw, options.spread);
+	}
+	region.stages.push_back(localization.stop("localization"));
+	log << " ==> " << region.lines.size() + 1 << " lines found. " << format_stage(region.stages.back()) << endl;
+	calibration.measure(LOCALIZATION_STAGE, region.stages.back().peak_bytes, LOCALIZATION_BYTES * pixels / (decimation * decimation));
+	if (budget > 0 and region.stages.back().peak_bytes > budget) {
+		log << "- WARNING! localization peaked at " << format_bytes(region.stages.back().peak_bytes) << ", over the budget" << endl;
+	}
+
+	bool cost_field = true;
+	double search_bytes = SEARCH_STATE_BYTES * calibration.factor(SEARCH_STAGE);
+	auto search_estimate = [&] () {
+		return search_bytes * searched_pixels(area.size(), region.corridor > 0 ? region.corridor : options.corridor);
+	};
+	if (budget > 0) {
+		double map_factor = calibration.factor(MAP_STAGE);
+		auto estimate = [&] () {
+			return map_factor * map_bytes(options, cost_field) * pixels + search_estimate();
+		};
+		if (estimate() > budget and options.corridor == 0 and region.lines.size() > 1) {
+			region.corridor = budget_corridor(region.lines);
+			log << "- Memory budget: corridor of " << region.corridor << " rows." << endl;
+		}
+		if (estimate() > budget and options.solver != "dp") {
+			cost_field = false;
+			log << "- Memory budget: costs computed during the search." << endl;
+		}
+		if (estimate() > budget) {
+			log << "- WARNING! about " << format_bytes((size_t) estimate()) << " needed, over the budget of ";
+			log << format_bytes(options.memory_budget) << endl;
+		}
+	}
+
+	StageMeter mapping;
+	log << "- Building the search map..";
+	region.map = build_map(imbw, options, cost_field, &region.stages);
+	StageStats transform = region.stages.back();
+	region.stages.push_back(mapping.stop("map"));
+	log << " ==> " << format_stage(region.stages.back()) << endl;
+	log << "\t distance transform " << format_stage(transform) << endl;
+	calibration.measure(MAP_STAGE, region.stages.back().peak_bytes, map_bytes(options, cost_field) * pixels);
+
+	// The map as built, not as estimated, is what the search has to fit next to.
+	if (budget > 0 and region.map.bytes() + search_estimate() > budget) {
+		if (options.corridor == 0 and region.corridor == 0 and region.lines.size() > 1) {
+			region.corridor = budget_corridor(region.lines);
+			log << "- Memory budget: the map takes " << format_bytes(region.map.bytes()) << ", corridor of ";
+			log << region.corridor << " rows." << endl;
+		}
+		if (region.map.bytes() + search_estimate() > budget and !region.map.costs.empty() and options.solver != "dp") {
+			region.map.costs = Raster<float>();
+			log << "- Memory budget: the map takes " << format_bytes(region.map.bytes()) << " without its cost field." << endl;
+		}
+	}
+
+	region.log = log.str();
+	return region;
+}
+
+/*
+ * Searches a separating path for every line of a prepared region. The map
+ * must have been built with the node weights of `options` (see
+ * compute_cost_field). With a memory budget, the tracked peak is checked
+ * after every line: if the map and the search state outgrow the budget,
+ * the remaining lines are searched in a corridor (see prepare_region). The
+ * peak calibrates the estimate of the search state.
+ */
+inline RegionPaths search_region (const PreparedRegion& prepared, const SearchOptions& options) {
+
+	typedef Map::Node Node;
+	const Map& map = prepared.map;
+	Rect area = prepared.area;
+	RegionPaths region;
+	region.area = area;
+	region.lines = prepared.lines;
+	region.stages = prepared.stages;
+	ostringstream log;
+	StageMeter search;
+	int corridor = prepared.corridor > 0 ? prepared.corridor : options.corridor;
+
+	bool dp = options.solver == "dp";
+	log << "- " << (dp ? "DP path solver" : "A* path planning algorithm") << " (" << layout_name(options.layout) << " rasters).." << endl;
+	SearchState state;
+	if (corridor <= 0) {
+		state = SearchState(Rect(0, 0, map.walls.cols, map.walls.rows), options.layout);
+	}
+	double searched = searched_pixels(area.size(), corridor);
+	WorkerPool pool(options.search_threads > 1 ? options.search_threads : 0);  // shared by the searches of all the lines
+
+	int end;
+	if ((map.walls.cols - 1) % 2 == 0) {
+		end = map.walls.cols - 1;
+	} else {
+		end = map.walls.cols - 2;
+	}
+
+	for (vector<int>::iterator itr = region.lines.begin(); itr != region.lines.end(); itr++) {
+
+		chrono::steady_clock::time_point _start = chrono::steady_clock::now();
+
+		Node start{*itr, 0};
+		Node goal{*itr, end};
+
+		// A corridor bounds the search to the rows around the seed, and the state to their size.
+		if (corridor > 0) {
+			state = SearchState();
+			int top = max(*itr - corridor, 0);
+			int bottom = min(*itr + corridor + 1, map.walls.rows);
+			state = SearchState(Rect(0, top, map.walls.cols, bottom - top), options.layout);
+		}
+
+		log << "\t#" << to_string(distance(region.lines.begin(), itr) + 1) + " - from [" << get<0>(start) + area.y << ", " << get<1>(start) + area.x << "]";
+		log << " to [" << get<0>(goal) + area.y << ", " << get<1>(goal) + area.x << "]";
+
+		size_t expansions;
+		if (dp) {
+			expansions = wavefront_search(map, start, goal, state, options.weights, options.step, options.search_threads, &pool);
+		} else {
+			expansions = parallel_astar_search(map, start, goal, state, options.weights, options.step, options.mfactor,
+											   options.search_threads, &pool);
+		}
+		region.paths.push_back(reconstruct_path(map, start, goal, state));
+		region.expansions += expansions;
+
+		double elapsed = chrono::duration<double>(chrono::steady_clock::now() - _start).count();
+		log << " ==> path found in " + to_string(elapsed) << " s";
+		log << " (" << expansions << " expansions)" << endl;
+
+		size_t used = map.bytes() + search.peak();
+		if (options.memory_budget > 0 and used > options.memory_budget and corridor <= 0 and region.lines.size() > 1) {
+			corridor = budget_corridor(region.lines);
+			log << "- Memory budget: " << format_bytes(used) << " used, corridor of " << corridor << " rows from here on." << endl;
+		}
+	}
+
+	region.stages.push_back(search.stop("search"));
+	memory_calibration().measure(SEARCH_STAGE, region.stages.back().peak_bytes, SEARCH_STATE_BYTES * searched);
+	log << "- Paths found " << format_stage(region.stages.back()) << endl;
+	region.log = log.str();
+	return region;
+}
+
+/*
+ * Localizes the lines of `area` and searches a separating path for each of
+ * them. The progress messages go to the returned log rather than to cout,
+ * so that regions can be processed concurrently.
+ */
+inline RegionPaths find_region_paths (const Mat& page, Rect area, const SearchOptions& options) {
+	PreparedRegion prepared = prepare_region(page, area, options);
+	RegionPaths region = search_region(prepared, options);
+	region.log = prepared.log + region.log;
+	return region;
+}
+
+/*
+ * Runs find_region_paths on every area, one thread per area. A memory
+ * budget is for the whole page: the page image and its grid are taken off
+ * it and the rest is shared among the areas by size.
+ */
+inline vector<RegionPaths> find_paths (const Mat& page, const vector<Rect>& areas, const SearchOptions& options) {
+
+	vector<SearchOptions> area_options(areas.size(), options);
+	if (options.memory_budget > 0) {
+		double total = 0;
+		for (Rect area : areas) {
+			total += area.area();
+		}
+		double left = max((double) options.memory_budget - 2.0 * page.total(), 0.0);
+		for (unsigned int k = 0; k < areas.size(); k++) {
+			area_options[k].memory_budget = max((size_t) (left * areas[k].area() / max(total, 1.0)), (size_t) 1);
+		}
+	}
+
+	vector<RegionPaths> regions(areas.size());
+	if (areas.size() == 1) {
+		regions[0] = find_region_paths(page, areas[0], area_options[0]);
+		return regions;
+	}
+
+	vector<thread> workers;
+	for (unsigned int k = 0; k < areas.size(); k++) {
+		workers.push_back(thread([&, k] () {
+			regions[k] = find_region_paths(page, areas[k], area_options[k]);
+		}));
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	return regions;
+}
+
+struct PageOptions {
+
+	double scale;  // the page is decimated to this fraction of its resolution first
+	bool deskew;
+	bool crop;
+	bool columns;
+
+	PageOptions () : scale(1), deskew(false), crop(false), columns(false) {}
+
+};
+
+/*
+ * Optional decimation, deskewing, text area cropping and column splitting
+ * of a grayscale page: returns the regions to segment, in page
+ * coordinates. `im` is replaced by the decimated and deskewed page. A
+ * decimated page is evaluated against the groundtruth store of its scale;
+ * the paths of a deskewed one do not line up with the groundtruth of the
+ * original. Progress goes to `log`.
+ */
+inline vector<Rect> page_areas (Mat& im, const PageOptions& page, ostream& log) {
+
+	if (page.scale != 1) {
+		resize(im, im, Size(), page.scale, page.scale, INTER_AREA);
+		log << "- Decimated to " << im.cols << "x" << im.rows << "." << endl;
+	}
+
+	if (page.deskew) {
+		log << "- Estimating skew..";
+		double angle = estimate_skew(im);
+		log << " ==> " << angle << " degrees." << endl;
+		if (fabs(angle) >= 0.05) {
+			im = deskew(im, angle);
+		}
+	}
+
+	// Every later stage works on views of the text block; paths are moved back to page coordinates for drawing.
+	Rect area(0, 0, im.cols, im.rows);
+	if (page.crop) {
+		log << "- Cropping text area..";
+		area = detect_text_area(im);
+		log << " ==> " << area.width << "x" << area.height << " at [" << area.y << ", " << area.x << "]" << endl;
+	}
+
+	vector<Rect> areas{area};
+	if (page.columns) {
+		log << "- Detecting columns..";
+		Mat text = im(area);
+		areas.clear();
+		for (Rect column : detect_columns(text)) {
+			areas.push_back(Rect(column.x + area.x, column.y + area.y, column.width, column.height));
+		}
+		log << " ==> " << areas.size() << " columns found." << endl;
+	}
+
+	return areas;
+}
+
+// The whole segmentation of a grayscale page: page_areas, then localization and search in every region.
+inline vector<RegionPaths> segment_page (Mat& im, const PageOptions& page, const SearchOptions& options, ostream& log) {
+	return find_paths(im, page_areas(im, page, log), options);
+}
+
+/*
+ * The text lines of a region as 0/255 images of its full width, as
+ * save_region_lines writes them. `grid` is the 0/1 image of the whole page.
+ */
+inline vector<Mat> region_line_images (Mat& grid, const RegionPaths& region) {
+
+	Mat input = grid(region.area);
+	const vector<vector<Map::Node>>& paths = region.paths;
+	vector<Mat> images;
+
+	if (paths.empty()) {
+		images.push_back(input*255);
+		return images;
+	}
+
+	for (unsigned int k = 0; k < paths.size(); k++) {
+		if (k >= 1) {  // use upper and lower boundary for segmentation
+			images.push_back(text_line_image(input, paths[k], paths[k - 1])*255);
+		} else {  // use only lower bound for first line
+			images.push_back(text_line_image(input, true, paths[k])*255);
+		}
+	}
+
+	// Segment the last text line.
+	images.push_back(text_line_image(input, false, paths.back())*255);
+	return images;
+}
+
+/*
+ * Saves the text lines of a region as line_<n>.jpg in `out_dir`, numbering
+ * them from `n_lines` + 1 on, through `io` if given. `grid` is the 0/1
+ * image of the whole page.
+ */
+inline void save_region_lines (Mat& grid, const RegionPaths& region, string out_dir, int& n_lines, AsyncIo* io = nullptr) {
+	for (const Mat& image : region_line_images(grid, region)) {
+		save_image(out_dir + "line_" + to_string(++n_lines) + ".jpg", image, io);
+	}
+}
+
+#endif
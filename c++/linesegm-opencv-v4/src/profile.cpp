@@ -0,0 +1,111 @@
+/*
+ * profile.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef PROFILE_CPP
+#define PROFILE_CPP
+
+#include "pipeline.cpp"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+
+/*
+ * Search parameters tuned for a collection (tune_profile), saved as
+ * profiles/<name>.profile: one key=value per line, # starts a comment.
+ * Loaded with --profile, they replace the weights picked by infer_dataset.
+ */
+struct Profile {
+
+	string name;
+	int step;
+	int mfactor;
+	int corridor;
+	CostWeights weights;
+	double hitrate;         // measured on the tuning sample
+	double search_seconds;
+	int pages;
+
+	Profile () : step(2), mfactor(5), corridor(0), hitrate(0), search_seconds(0), pages(0) {}
+
+};
+
+// profiles/<name>.profile, or `name` itself if it is a path.
+inline string profile_path (string name) {
+	if (name.find('/') != string::npos or name.find(".profile") != string::npos) {
+		return name;
+	}
+	return "profiles/" + name + ".profile";
+}
+
+inline bool save_profile (const Profile& profile) {
+
+	string path = profile_path(profile.name);
+	if (path.compare(0, 9, "profiles/") == 0) {
+		ensure_directory_exists("profiles/");
+	}
+	ofstream file(path.c_str());
+	file << "# linesegm search profile '" << profile.name << "'" << endl;
+	file << "# tuned on " << profile.pages << " pages: hit rate " << profile.hitrate;
+	file << ", " << profile.search_seconds << " s of search" << endl;
+	file << "step=" << profile.step << endl;
+	file << "mfactor=" << profile.mfactor << endl;
+	file << "corridor=" << profile.corridor << endl;
+	file << "wv=" << profile.weights.vertical << endl;
+	file << "wn=" << profile.weights.neighbor << endl;
+	file << "wm=" << profile.weights.ink << endl;
+	file << "wd=" << profile.weights.distance << endl;
+	file << "wd2=" << profile.weights.distance2 << endl;
+	file.close();
+	return !file.fail();
+}
+
+// Keys missing from the file keep their defaults; unknown keys are an error.
+inline bool load_profile (string name, Profile& profile) {
+
+	ifstream file(profile_path(name).c_str());
+	if (!file) {
+		cout << "ERROR! no profile " << profile_path(name) << endl;
+		return false;
+	}
+
+	profile = Profile();
+	profile.name = name;
+	string line;
+	while (getline(file, line)) {
+		if (line.empty() or line[0] == '#') {
+			continue;
+		}
+		size_t eq = line.find('=');
+		string key = line.substr(0, eq);
+		double value = eq == string::npos ? 0 : atof(line.c_str() + eq + 1);
+		if (key == "step") profile.step = min(max((int) value, 1), 2);
+		else if (key == "mfactor") profile.mfactor = (int) value;
+		else if (key == "corridor") profile.corridor = max((int) value, 0);
+		else if (key == "wv") profile.weights.vertical = value;
+		else if (key == "wn") profile.weights.neighbor = value;
+		else if (key == "wm") profile.weights.ink = value;
+		else if (key == "wd") profile.weights.distance = value;
+		else if (key == "wd2") profile.weights.distance2 = value;
+		else {
+			cout << "ERROR! bad line '" << line << "' in " << profile_path(name) << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+inline void apply_profile (const Profile& profile, SearchOptions& options) {
+	options.step = profile.step;
+	options.mfactor = profile.mfactor;
+	options.corridor = profile.corridor;
+	options.weights = profile.weights;
+	options.fixed_weights = true;
+}
+
+#endif
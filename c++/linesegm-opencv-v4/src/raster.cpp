@@ -0,0 +1,106 @@
+/*
+ * raster.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef RASTER_CPP
+#define RASTER_CPP
+
+#include "opencv2/opencv.hpp"
+#include "instrumentation.cpp"
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Memory layout of the rasters read during the search.
+ * ROW_MAJOR is the plain OpenCV order. TILED stores the raster as 64x64
+ * tiles, so the three rows touched by an expansion share a few cache lines
+ * instead of being a full image row apart.
+ */
+enum RasterLayout { ROW_MAJOR, TILED };
+
+const int TILE_SHIFT = 6;
+const int TILE_SIZE = 1 << TILE_SHIFT;
+const int TILE_MASK = TILE_SIZE - 1;
+
+// Returns false if `name` is not a layout.
+inline bool parse_layout (string name, RasterLayout& layout) {
+	if (name == "rowmajor" or name == "row-major") {
+		layout = ROW_MAJOR;
+	} else if (name == "tiled") {
+		layout = TILED;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+inline string layout_name (RasterLayout layout) {
+	return layout == TILED ? "tiled" : "row-major";
+}
+
+template<typename T>
+struct Raster {
+
+	int rows;
+	int cols;
+	RasterLayout layout;
+	int tiles_per_row;
+	TrackedVector<T> data;
+
+	Raster () : rows(0), cols(0), layout(ROW_MAJOR), tiles_per_row(0) {}
+
+	Raster (int rows, int cols, RasterLayout layout, T value = T()) : rows(rows), cols(cols), layout(layout),
+			tiles_per_row((cols + TILE_MASK) >> TILE_SHIFT) {
+		if (layout == TILED) {
+			size_t tiles = (size_t) tiles_per_row * ((rows + TILE_MASK) >> TILE_SHIFT);
+			data.assign(tiles << (2 * TILE_SHIFT), value);
+		} else {
+			data.assign((size_t) rows * cols, value);
+		}
+	}
+
+	// Copies a single channel Mat whose element type is T.
+	Raster (const Mat& m, RasterLayout layout) : Raster(m.rows, m.cols, layout) {
+		for (int i = 0; i < rows; i++) {
+			const T* src = m.ptr<T>(i);
+			for (int j = 0; j < cols; j++) {
+				data[index(i, j)] = src[j];
+			}
+		}
+	}
+
+	inline bool empty () const {
+		return data.empty();
+	}
+
+	inline size_t index (int row, int col) const {
+		if (layout == TILED) {
+			size_t tile = (size_t) (row >> TILE_SHIFT) * tiles_per_row + (col >> TILE_SHIFT);
+			return (tile << (2 * TILE_SHIFT)) + ((row & TILE_MASK) << TILE_SHIFT) + (col & TILE_MASK);
+		}
+		return (size_t) row * cols + col;
+	}
+
+	inline T& at (int row, int col) {
+		return data[index(row, col)];
+	}
+
+	inline const T& at (int row, int col) const {
+		return data[index(row, col)];
+	}
+
+	inline void fill (T value) {
+		std::fill(data.begin(), data.end(), value);
+	}
+
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * rasterize.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef RASTERIZE_CPP
+#define RASTERIZE_CPP
+
+#include "opencv2/opencv.hpp"
+#include "utils.cpp"
+#include "sauvola.cpp"
+#include "pagexml.cpp"
+#include "gtstore.cpp"
+#include "instrumentation.cpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+
+struct RasterOptions {
+
+	double scale;    // 1 rasterizes at the resolution of the images, 0.5 at half of it
+	bool binarized;  // the images are already black and white, threshold them at 128 instead of Sauvola
+	int jobs;
+
+	RasterOptions () : scale(1), binarized(false), jobs(1) {}
+
+};
+
+/*
+ * Labels with `label` the ink pixels of `ink` (0 = ink) inside `polygon`,
+ * filled as cv::fillPoly does, so over its bounding box only.
+ */
+inline void fill_line (Mat& labels, const Mat& ink, const vector<Point>& polygon, ushort label) {
+
+	Rect box = boundingRect(polygon) & Rect(0, 0, labels.cols, labels.rows);
+	if (box.width <= 0 or box.height <= 0) {
+		return;
+	}
+	Mat inside = Mat::zeros(box.height, box.width, CV_8U);
+	vector<vector<Point>> polygons{polygon};
+	fillPoly(inside, polygons, Scalar(1), LINE_8, 0, Point(-box.x, -box.y));
+
+	for (int i = 0; i < box.height; i++) {
+		const uchar* in = inside.ptr<uchar>(i);
+		const uchar* b = ink.ptr<uchar>(box.y + i) + box.x;
+		ushort* l = labels.ptr<ushort>(box.y + i) + box.x;
+		for (int j = 0; j < box.width; j++) {
+			if (in[j] and b[j] == 0) {
+				l[j] = label;
+			}
+		}
+	}
+}
+
+/*
+ * Rasterizes the text lines of a PAGE-XML file into a label map of the
+ * page, as the line images of create_groundtruth.py would decode: the
+ * binarized ink of the page inside the polygon of every line. The lines are
+ * named ground_<n>.jpg and labelled in sorted name order, so overlaps are
+ * resolved as when the store is built from those images. Errors go to `log`.
+ */
+inline bool rasterize_page (string xml_path, string images_folder, const RasterOptions& options, Mat& labels,
+							vector<string>& names, string& image_name, ostream& log) {
+
+	PageGroundtruth page;
+	if (!parse_page_xml(xml_path, page)) {
+		log << "\tERROR! could not read " << xml_path << endl;
+		return false;
+	}
+
+	// The images of the collection may have been converted to jpg since the xml was written.
+	image_name = page.image;
+	Mat im = imread(images_folder + image_name, 0);
+	if (im.empty()) {
+		image_name = image_name.substr(0, image_name.rfind('.')) + ".jpg";
+		im = imread(images_folder + image_name, 0);
+	}
+	if (im.empty()) {
+		log << "\tERROR! could not read the image " << page.image << endl;
+		return false;
+	}
+
+	// The coordinates are those of the image the xml was written for, which may have been resized since.
+	double sx = options.scale, sy = options.scale;
+	if (page.width > 0 and page.height > 0) {
+		sx = options.scale * im.cols / page.width;
+		sy = options.scale * im.rows / page.height;
+	}
+	if (options.scale != 1) {
+		resize(im, im, Size(), options.scale, options.scale, INTER_AREA);
+	}
+
+	StageMeter binarization;
+	Mat ink(im.rows, im.cols, CV_8U);
+	if (options.binarized) {
+		threshold(im, ink, 127, 255, THRESH_BINARY);
+	} else {
+		binarize(im, ink, max((int) round(20 * options.scale), 3), 128, 0.3);
+	}
+	StageStats stats = binarization.stop("binarization");
+	if (stats.perf.any()) {
+		log << "\t" << image_name << " binarized " << format_stage(stats) << endl;
+	}
+
+	int n = (int) page.lines.size();
+	names.clear();
+	for (int k = 0; k < n; k++) {
+		names.push_back("ground_" + to_string(k + 1) + ".jpg");
+	}
+	vector<int> order(n);
+	for (int k = 0; k < n; k++) {
+		order[k] = k;
+	}
+	sort(order.begin(), order.end(), [&names] (int a, int b) { return names[a] < names[b]; });
+
+	labels = Mat::zeros(im.size(), CV_16U);
+	vector<string> sorted;
+	for (int k = 0; k < n; k++) {
+		vector<Point> polygon;
+		for (Point p : page.lines[order[k]]) {
+			polygon.push_back(Point((int) round(p.x * sx), (int) round(p.y * sy)));
+		}
+		if (!polygon.empty()) {
+			fill_line(labels, ink, polygon, (ushort) (k + 1));
+		}
+		sorted.push_back(names[order[k]]);
+	}
+	names.swap(sorted);
+	return true;
+}
+
+/*
+ * Rasterizes every PAGE-XML file of `xml_folder` into <out_folder>/<page>.gtl,
+ * the store load_groundtruth reads for the page, or <page>@<scale>.gtl at a
+ * scale other than 1, `options.jobs` pages at a time. The page logs are printed in input order. Returns the number of
+ * pages written.
+ */
+inline int rasterize_groundtruth (string xml_folder, string images_folder, string out_folder, const RasterOptions& options) {
+
+	vector<string> xmls;
+	for (string name : read_folder(xml_folder.c_str())) {
+		if (name.size() > 4 and name.compare(name.size() - 4, 4, ".xml") == 0) {
+			xmls.push_back(name);
+		}
+	}
+	sort(xmls.begin(), xmls.end());
+
+	vector<string> logs(xmls.size());
+	atomic<size_t> next(0);
+	atomic<int> written(0);
+	auto work = [&] () {
+		for (size_t k = next++; k < xmls.size(); k = next++) {
+			ostringstream log;
+			Mat labels;
+			vector<string> names;
+			string image;
+			if (rasterize_page(xml_folder + xmls[k], images_folder, options, labels, names, image, log)) {
+				string path = groundtruth_store_path(out_folder + image.substr(0, image.rfind('.')), options.scale);
+				if (write_groundtruth_store(path, labels, names)) {
+					log << "\t" << xmls[k] << " ==> " << path << " (" << names.size() << " lines)" << endl;
+					written++;
+				} else {
+					log << "\tERROR! could not write " << path << endl;
+				}
+			}
+			logs[k] = log.str();
+		}
+	};
+
+	vector<thread> workers;
+	for (int t = 0; t < max(options.jobs, 1); t++) {
+		workers.push_back(thread(work));
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	for (const string& log : logs) {
+		cout << log;
+	}
+	return written;
+}
+
+#endif
@@ -5,6 +5,8 @@
  *      Author: saverio
  */
 
+#ifndef SAUVOLA_CPP
+#define SAUVOLA_CPP
 
 #include "opencv2/opencv.hpp"
 
@@ -160,3 +162,5 @@ inline void binarize (Mat& im, Mat& output, int window, double dr, double k) {
 	}
 
 }
+
+#endif
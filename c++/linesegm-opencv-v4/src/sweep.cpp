@@ -0,0 +1,266 @@
+/*
+ * sweep.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef SWEEP_CPP
+#define SWEEP_CPP
+
+#include "opencv2/opencv.hpp"
+#include "pipeline.cpp"
+#include "evaluation.cpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * One point of a parameter grid. The weights not set here keep the values
+ * of the dataset of every page (dataset_weights).
+ */
+struct SweepConfig {
+
+	int step;
+	int mfactor;
+	int corridor;
+	vector<pair<string, double>> weights;  // key of the grid and value
+
+	// Sets the parameter of a grid key, replacing the previous value of a weight.
+	inline void set (string key, double v) {
+		if (key == "s") step = min(max((int) v, 1), 2);
+		else if (key == "mf") mfactor = (int) v;
+		else if (key == "cw") corridor = max((int) v, 0);
+		else {
+			for (auto& weight : weights) {
+				if (weight.first == key) {
+					weight.second = v;
+					return;
+				}
+			}
+			weights.push_back(make_pair(key, v));
+		}
+	}
+
+	inline CostWeights apply (CostWeights base) const {
+		for (auto& weight : weights) {
+			if (weight.first == "wv") base.vertical = weight.second;
+			else if (weight.first == "wn") base.neighbor = weight.second;
+			else if (weight.first == "wm") base.ink = weight.second;
+			else if (weight.first == "wd") base.distance = weight.second;
+			else if (weight.first == "wd2") base.distance2 = weight.second;
+		}
+		return base;
+	}
+
+	inline string name () const {
+		ostringstream out;
+		for (unsigned int k = 0; k < weights.size(); k++) {
+			out << (k > 0 ? " " : "") << weights[k].first << "=" << weights[k].second;
+		}
+		return out.str();
+	}
+
+};
+
+/*
+ * Parses a grid such as "s=1,2;mf=5,10;wv=0.5,2.5" into the cartesian
+ * product of its values. Keys: s (step), mf (mfactor), cw (corridor) and
+ * the cost weights wv (vertical), wn (neighbor), wm (ink), wd (distance) and
+ * wd2 (distance squared). Missing keys keep the values of `options`. Returns no config if
+ * the grid is malformed.
+ */
+inline vector<SweepConfig> parse_sweep_grid (string grid, const SearchOptions& options) {
+
+	SweepConfig base;
+	base.step = options.step;
+	base.mfactor = options.mfactor;
+	base.corridor = options.corridor;
+	vector<SweepConfig> configs{base};
+
+	stringstream axes(grid);
+	string axis;
+	while (getline(axes, axis, ';')) {
+		size_t eq = axis.find('=');
+		string key = axis.substr(0, eq);
+		if (eq == string::npos or (key != "s" and key != "mf" and key != "cw" and key != "wv" and key != "wn" and key != "wm"
+								   and key != "wd" and key != "wd2")) {
+			cout << "ERROR! bad sweep axis '" << axis << "'" << endl;
+			return vector<SweepConfig>();
+		}
+
+		vector<double> values;
+		stringstream list(axis.substr(eq + 1));
+		string value;
+		while (getline(list, value, ',')) {
+			values.push_back(atof(value.c_str()));
+		}
+		if (values.empty()) {
+			cout << "ERROR! no values for '" << key << "'" << endl;
+			return vector<SweepConfig>();
+		}
+
+		vector<SweepConfig> product;
+		for (const SweepConfig& config : configs) {
+			for (double v : values) {
+				SweepConfig next = config;
+				next.set(key, v);
+				product.push_back(next);
+			}
+		}
+		configs.swap(product);
+	}
+	return configs;
+}
+
+// Totals of one config over the pages evaluated so far.
+struct SweepResult {
+
+	int pages;
+	double hitrate;
+	double detection_gt;
+	double detection_r;
+	int correctly_detected;
+	int lines;
+	double search_seconds;
+	size_t expansions;
+
+	SweepResult () : pages(0), hitrate(0), detection_gt(0), detection_r(0), correctly_detected(0), lines(0),
+			search_seconds(0), expansions(0) {}
+
+	inline double mean_hitrate () const {
+		return pages > 0 ? hitrate / pages : 0;
+	}
+
+};
+
+/*
+ * Segments and evaluates `filenames` once per config. Reading, deskewing,
+ * cropping, localization, distance transform and groundtruth decoding are
+ * done once per page; only the searches, and the cost field when a config
+ * changes the node weights, are redone for every config. The configs of a
+ * page run on `jobs` threads.
+ */
+inline vector<SweepResult> evaluate_configs (const vector<string>& filenames, const PageOptions& page,
+											 const SearchOptions& options, const vector<SweepConfig>& configs, int jobs) {
+
+	vector<SweepResult> results(configs.size());
+
+	for (string filename : filenames) {
+
+		ostringstream log;
+		SearchOptions page_options = options;
+		select_dataset(page_options, filename);
+		cout << "\t" << filename << " (" << page_options.dataset << ")" << endl;
+
+		Mat im = imread(filename, 0);
+		if (im.empty()) {
+			cout << "\tERROR! could not read the image" << endl;
+			continue;
+		}
+
+		vector<PreparedRegion> regions;
+		for (Rect area : page_areas(im, page, log)) {
+			regions.push_back(prepare_region(im, area, page_options));
+		}
+
+		Mat page_grid = im / 255;
+		string name = page_name(filename, page_options.dataset);
+		GroundtruthStore store;
+		if (!load_groundtruth("data/" + page_options.dataset + "/groundtruth/" + name + "/", page_grid.size(), store, page.scale)) {
+			continue;
+		}
+		vector<LineMask> groundtruth = groundtruth_masks(store);
+		vector<string> names = store.names();
+
+		atomic<size_t> next(0);
+		auto work = [&] () {
+			ostream discard(nullptr);
+			for (size_t c = next++; c < configs.size(); c = next++) {
+
+				SearchOptions config_options = page_options;
+				config_options.step = configs[c].step;
+				config_options.mfactor = configs[c].mfactor;
+				config_options.corridor = configs[c].corridor;
+				config_options.weights = configs[c].apply(page_options.weights);
+				bool same_costs = config_options.weights.same_node_terms(page_options.weights);
+
+				vector<LineMask> lines;
+				for (const PreparedRegion& region : regions) {
+					chrono::steady_clock::time_point start = chrono::steady_clock::now();
+					RegionPaths paths;
+					if (same_costs) {
+						paths = search_region(region, config_options);
+					} else {
+						PreparedRegion reweighted = region;
+						reweighted.map.costs = compute_cost_field(reweighted.map, config_options.weights, config_options.layout);
+						start = chrono::steady_clock::now();
+						paths = search_region(reweighted, config_options);
+					}
+					results[c].search_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+					results[c].expansions += paths.expansions;
+					mask_region_lines(page_grid, paths.area, paths.paths, lines);
+				}
+
+				PageStats stats = evaluate_page(name, names, compute_overlaps(groundtruth, lines), discard);
+				results[c].pages++;
+				results[c].hitrate += stats.hitrate;
+				results[c].detection_gt += stats.detection_gt;
+				results[c].detection_r += stats.detection_r;
+				results[c].correctly_detected += stats.correctly_detected;
+				results[c].lines += stats.lines;
+			}
+		};
+
+		vector<thread> workers;
+		for (int t = 0; t < min(jobs, (int) configs.size()); t++) {
+			workers.push_back(thread(work));
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+	return results;
+}
+
+/*
+ * Evaluates every config of `grid` (parse_sweep_grid) on `filenames`. The
+ * averages over the pages go to data/sweep.csv and to a table, with the
+ * search time of every config.
+ */
+inline void run_sweep (const vector<string>& filenames, const PageOptions& page, const SearchOptions& options,
+					   string grid, int jobs) {
+
+	vector<SweepConfig> configs = parse_sweep_grid(grid, options);
+	if (configs.empty()) {
+		return;
+	}
+	cout << "\n- Sweeping " << configs.size() << " configurations over " << filenames.size() << " pages.." << endl;
+	vector<SweepResult> results = evaluate_configs(filenames, page, options, configs, jobs);
+
+	ofstream csvfile("data/sweep.csv");
+	csvfile << "step,mfactor,corridor,weights,pages,hitrate,detection_gt,detection_r,correct,lines,search_seconds,expansions\n";
+	cout << "\n## step  mf  corridor  hit rate  det. GT  det. R  correct     search s  weights" << endl;
+	for (unsigned int c = 0; c < configs.size(); c++) {
+		const SweepResult& r = results[c];
+		int pages = max(r.pages, 1);
+		csvfile << configs[c].step << "," << configs[c].mfactor << "," << configs[c].corridor << "," << configs[c].name() << "," << r.pages << ",";
+		csvfile << r.hitrate / pages << "," << r.detection_gt / pages << "," << r.detection_r / pages << ",";
+		csvfile << r.correctly_detected << "," << r.lines << "," << r.search_seconds << "," << r.expansions << "\n";
+
+		char row[128];
+		snprintf(row, sizeof(row), "   %4d %3d  %8d  %8.4f  %7.4f  %6.4f  %6d/%-6d %8.2f  ", configs[c].step, configs[c].mfactor, configs[c].corridor,
+				 r.hitrate / pages, r.detection_gt / pages, r.detection_r / pages, r.correctly_detected, r.lines, r.search_seconds);
+		cout << row << configs[c].name() << endl;
+	}
+	csvfile.close();
+	cout << "\n- Results saved to data/sweep.csv" << endl;
+}
+
+#endif
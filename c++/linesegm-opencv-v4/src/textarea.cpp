@@ -0,0 +1,110 @@
+/*
+ * textarea.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef TEXTAREA_CPP
+#define TEXTAREA_CPP
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Picks the densest block of a projection profile: the positions holding at
+ * least `min_ink` ink pixels are grouped into runs, bridging gaps shorter
+ * than `max_gap`, and the run with the most ink wins. Returns [begin, end).
+ */
+inline pair<int, int> densest_run (const vector<int>& profile, int min_ink, int max_gap) {
+	pair<int, int> best(0, (int) profile.size());
+	long best_mass = -1;
+	int begin = -1, last = -1;
+	long mass = 0;
+
+	for (int i = 0; i <= (int) profile.size(); i++) {
+		bool active = i < (int) profile.size() and profile[i] >= min_ink;
+		if (active and begin >= 0 and i - last > max_gap) {
+			if (mass > best_mass) {
+				best_mass = mass;
+				best = make_pair(begin, last + 1);
+			}
+			begin = -1;
+		}
+		if (active) {
+			if (begin < 0) {
+				begin = i;
+				mass = 0;
+			}
+			last = i;
+			mass += profile[i];
+		}
+		if (i == (int) profile.size() and begin >= 0 and mass > best_mass) {
+			best_mass = mass;
+			best = make_pair(begin, last + 1);
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Finds the bounding box of the text block from the row and column ink
+ * projections of a downsampled copy of the page, so that blank borders,
+ * ruler strips and colour targets separated from the text by a wide blank
+ * gap are left out. The box is padded by `margin` pixels and clipped to the
+ * page. Returns the whole page if no ink is found.
+ */
+inline Rect detect_text_area (const Mat& im, int margin = 20) {
+
+	int factor = max(1, min(im.rows, im.cols) / 512);
+	Mat small;
+	resize(im, small, Size(max(im.cols / factor, 1), max(im.rows / factor, 1)), 0, 0, INTER_AREA);
+
+	vector<int> rows(small.rows, 0), cols(small.cols, 0);
+	for (int i = 0; i < small.rows; i++) {
+		const uchar* p = small.ptr<uchar>(i);
+		for (int j = 0; j < small.cols; j++) {
+			if (p[j] < 128) {
+				rows[i]++;
+			}
+		}
+	}
+
+	pair<int, int> rr = densest_run(rows, max(1, small.cols / 500), max(2, small.rows / 25));
+	for (int i = rr.first; i < rr.second; i++) {
+		const uchar* p = small.ptr<uchar>(i);
+		for (int j = 0; j < small.cols; j++) {
+			if (p[j] < 128) {
+				cols[j]++;
+			}
+		}
+	}
+	pair<int, int> cr = densest_run(cols, max(1, (rr.second - rr.first) / 500), max(2, small.cols / 25));
+
+	if (rr.second <= rr.first or cr.second <= cr.first) {
+		return Rect(0, 0, im.cols, im.rows);
+	}
+
+	int x0 = max(cr.first * factor - margin, 0);
+	int y0 = max(rr.first * factor - margin, 0);
+	int x1 = min(cr.second * factor + margin, im.cols);
+	int y1 = min(rr.second * factor + margin, im.rows);
+	return Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// Translates a path found inside `area` back to page coordinates.
+template<typename Node>
+inline vector<Node> offset_path (const vector<Node>& path, Rect area) {
+	vector<Node> moved;
+	moved.reserve(path.size());
+	for (auto node : path) {
+		moved.push_back(Node(get<0>(node) + area.y, get<1>(node) + area.x));
+	}
+	return moved;
+}
+
+#endif
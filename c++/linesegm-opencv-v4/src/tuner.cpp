@@ -0,0 +1,145 @@
+/*
+ * tuner.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef TUNER_CPP
+#define TUNER_CPP
+
+#include "sweep.cpp"
+#include "profile.cpp"
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+
+// Values tried for every parameter, one axis at a time.
+const vector<pair<string, vector<double>>> TUNER_AXES = {
+	{"s", {1, 2}},
+	{"mf", {1, 2, 5, 10, 20, 50}},
+	{"cw", {0, 25, 50, 100, 200}},
+	{"wv", {0.5, 1, 2.5, 5}},
+	{"wm", {25, 50, 100}},
+	{"wd", {100, 130, 150, 200}},
+	{"wd2", {0, 25, 50}},
+};
+
+inline string config_key (const SweepConfig& config) {
+	ostringstream key;
+	key << config.step << "/" << config.mfactor << "/" << config.corridor << "/" << config.name();
+	return key.str();
+}
+
+// Meeting the target beats missing it; then the faster, or the more accurate below the target.
+inline bool better_tuning (const SweepResult& a, const SweepResult& b, double target) {
+	bool a_meets = a.mean_hitrate() >= target, b_meets = b.mean_hitrate() >= target;
+	if (a_meets != b_meets) {
+		return a_meets;
+	}
+	if (a_meets) {
+		return a.search_seconds < b.search_seconds;
+	}
+	return a.mean_hitrate() > b.mean_hitrate();
+}
+
+/*
+ * Finds the fastest search parameters reaching a mean hit rate of `target`
+ * on `filenames` (every `filenames.size() / sample`-th page if `sample` is
+ * set), by coordinate descent: each round evaluates, with evaluate_configs,
+ * every value of every TUNER_AXES parameter around the current best, and
+ * moves to the best of them, until a round brings no change. Configs are
+ * evaluated once. The search times are measured while `jobs` configs run
+ * concurrently, so they compare configs rather than give absolute timings.
+ */
+inline Profile tune_profile (const vector<string>& filenames, const PageOptions& page, const SearchOptions& options,
+							 string name, double target, int sample, int jobs) {
+
+	vector<string> pages = filenames;
+	if (sample > 0 and sample < (int) filenames.size()) {
+		pages.clear();
+		for (int k = 0; k < sample; k++) {
+			pages.push_back(filenames[(size_t) k * filenames.size() / sample]);
+		}
+	}
+
+	// All the weights are set explicitly, so that the profile holds them whatever the dataset.
+	CostWeights base = options.fixed_weights or pages.empty() ? options.weights : dataset_weights(infer_dataset(pages[0]));
+	SweepConfig current;
+	current.step = options.step;
+	current.mfactor = options.mfactor;
+	current.corridor = options.corridor;
+	current.set("wv", base.vertical);
+	current.set("wn", base.neighbor);
+	current.set("wm", base.ink);
+	current.set("wd", base.distance);
+	current.set("wd2", base.distance2);
+
+	cout << "\n- Tuning '" << name << "' on " << pages.size() << " pages for a hit rate of " << target << ".." << endl;
+	map<string, SweepResult> evaluated;
+	for (int round = 1; ; round++) {
+
+		vector<SweepConfig> candidates;
+		vector<string> keys;
+		auto consider = [&] (const SweepConfig& config) {
+			string key = config_key(config);
+			if (!evaluated.count(key) and find(keys.begin(), keys.end(), key) == keys.end()) {
+				candidates.push_back(config);
+				keys.push_back(key);
+			}
+		};
+		consider(current);
+		for (auto& axis : TUNER_AXES) {
+			for (double value : axis.second) {
+				SweepConfig next = current;
+				next.set(axis.first, value);
+				consider(next);
+			}
+		}
+		cout << "- Round " << round << ": " << candidates.size() << " new configurations" << endl;
+		if (!candidates.empty()) {
+			vector<SweepResult> results = evaluate_configs(pages, page, options, candidates, jobs);
+			for (unsigned int c = 0; c < candidates.size(); c++) {
+				evaluated[keys[c]] = results[c];
+			}
+		}
+
+		SweepConfig best = current;
+		for (auto& axis : TUNER_AXES) {
+			for (double value : axis.second) {
+				SweepConfig next = current;
+				next.set(axis.first, value);
+				if (better_tuning(evaluated[config_key(next)], evaluated[config_key(best)], target)) {
+					best = next;
+				}
+			}
+		}
+
+		const SweepResult& r = evaluated[config_key(best)];
+		cout << "\t==> s " << best.step << ", mf " << best.mfactor << ", corridor " << best.corridor << ", " << best.name();
+		cout << ": hit rate " << r.mean_hitrate() << ", " << r.search_seconds << " s" << endl;
+		if (config_key(best) == config_key(current)) {
+			break;
+		}
+		current = best;
+	}
+
+	const SweepResult& r = evaluated[config_key(current)];
+	Profile profile;
+	profile.name = name;
+	profile.step = current.step;
+	profile.mfactor = current.mfactor;
+	profile.corridor = current.corridor;
+	profile.weights = current.apply(base);
+	profile.hitrate = r.mean_hitrate();
+	profile.search_seconds = r.search_seconds;
+	profile.pages = r.pages;
+	if (profile.hitrate < target) {
+		cout << "- WARNING! the target is not met, the most accurate configuration is kept." << endl;
+	}
+	return profile;
+}
+
+#endif
@@ -5,6 +5,8 @@
  *      Author: saverio
  */
 
+#ifndef UTILS_CPP
+#define UTILS_CPP
 
 #include "opencv2/opencv.hpp"
 #include <dirent.h>
@@ -27,14 +29,65 @@ inline void print_help () {
 	            "Options:\n"
 	            "\t-s integer \t\tStep value (1 or 2).\n"
 	            "             \t\t\tChange the step with which explore the map.\n"
+	            "\t-s auto    \t\tAdaptive step: strides of 2, 4 or 8 away from ink, 1 near it.\n"
+	            "\t-ac integer   \t\tClearance from ink required by the adaptive step (default 4).\n"
 	            "\t-mf integer   \t\tMultiplication factor (must be a positive integer).\n"
 	            "             \t\t\tIncrease the multiplication factor to obtain a non-admissible heuristic.\n"
+	            "\t-cw integer   \t\tCorridor: search only this many rows above and below each line.\n"
+	            "\t--skip-blank integer\tWalk rows with at least this vertical clearance from ink in a single\n"
+	            "             \t\t\tsweep instead of one move east at a time.\n"
+	            "\t--spread number\t\tPeak threshold of the line localization, in standard deviations of\n"
+	            "             \t\t\tthe row profile above its mean (default 0.66).\n"
+	            "\t--localize-only\t\tOnly localize the lines of the pages (-j at a time) and compare them\n"
+	            "             \t\t\twith the groundtruth; --spread takes a comma separated list to compare.\n"
+	            "             \t\t\tWrites data/<dataset>/lines.csv.\n"
+	            "\t--perf       \t\tAdd hardware counters (cycles, IPC, L1/LLC and branch misses) of the\n"
+	            "             \t\t\tcalling thread to the stage and page reports (perf_event_open).\n"
+	            "\t--mem-budget MB\t\tMemory budget of a page: regions that would exceed it are localized\n"
+	            "             \t\t\ton a decimated page and searched in a corridor around every line.\n"
+	            "\t--scale number\t\tSegment the pages decimated to this fraction of their resolution; --stats\n"
+	            "             \t\t\tthen reads the <page>@<scale>.gtl stores of bin/gtraster --scale.\n"
+	            "\t--deskew    \t\tEstimate the skew of the text lines and rotate the page straight.\n"
+	            "             \t\t\tNot available with the evaluation modes, whose groundtruth is unrotated.\n"
+	            "\t--crop      \t\tRun localization and search on the detected text area only.\n"
+	            "\t--columns   \t\tSplit the page into text columns and segment them in parallel.\n"
+	            "\t--tight-crops\t\tSave every line cropped to its ink rather than to the full width.\n"
+	            "\t--io name    \t\tFile I/O backend: uring (default, io_uring, falling back to threads\n"
+	            "             \t\t\twhere unavailable) or threads. The next page is read ahead and the\n"
+	            "             \t\t\toutputs are written in the background.\n"
+	            "\t--container path\t\tAppend the line images and paths of all the pages to this single\n"
+	            "             \t\t\tindexed file (read back with BatchReader) instead of data/line_<n>.jpg.\n"
+	            "\t--parallel-search integer\n"
+	            "             \t\t\tSearch every line with this many threads (hash-distributed A*),\n"
+	            "             \t\t\tworthwhile on very wide lines. Disables --skip-blank.\n"
+	            "\t--solver name\t\tPath solver: astar (default) or dp, a column by column dynamic\n"
+	            "             \t\t\tprogram for left to right separators, run on --parallel-search threads.\n"
+	            "\t--layout name\t\tMemory layout of the search rasters: rowmajor (default) or tiled.\n"
+	            "\t--corrections path\tReplay the corrections of an annotator (waypoint <path> <x> <y>,\n"
+	            "             \t\t\tink and erase <x> <y> <width> <height>, in page coordinates) and\n"
+	            "             \t\t\trepair only the paths they touch, checked against a fresh search.\n"
 	            "\t--stats	\t\tCompute and show statistics about the line segmentation.\n"
+	            "             \t\t\tThe groundtruth of a page is decoded once into <folder>.gtl.\n"
+	            "\t-j integer   \t\tWith --stats, evaluate this many pages in parallel without saving images.\n"
+	            "\t--sweep grid \t\tEvaluate every configuration of a parameter grid, e.g.\n"
+	            "             \t\t\t\"s=1,2;mf=5,10;wv=0.5,2.5\" (keys s, mf and the cost weights wv,\n"
+	            "             \t\t\twn, wm, wd, wd2), preprocessing each page once and running -j\n"
+	            "             \t\t\tconfigurations in parallel. Writes data/sweep.csv.\n"
+	            "\t--tune name  \t\tFind the fastest step, mfactor, corridor and cost weights reaching\n"
+	            "             \t\t\t--target-hitrate (default 0.9) on the given pages with groundtruth\n"
+	            "             \t\t\t(--sample n of them), and save them as profiles/<name>.profile.\n"
+	            "\t--profile name\t\tLoad the parameters of a tuned profile; later options override them.\n"
 	            "\t--help       \t\tShow this help information.\n"
 	            "\n"
 	            "Examples:\n"
 	            "\tbin/linesegm image.jpg -s 2 -mf 5 --stats\n"
 	            "\tbin/linesegm images/* -s 1 -mf 20 --stats\n"
+	            "\tbin/linesegm images/* -s auto -ac 6\n"
+	            "\tbin/linesegm data/saintgall/images/* --stats -j 8\n"
+	            "\tbin/linesegm data/saintgall/images/* --localize-only --spread 0.5,0.66,0.8 -j 8\n"
+	            "\tbin/linesegm data/saintgall/images/* --tune saintgall --sample 10 -j 8\n"
+	            "\tbin/linesegm data/saintgall/images/* --profile saintgall\n"
+	            "\tbin/linesegm data/saintgall/images/* --sweep \"s=1,2;mf=5,10,20\" -j 8\n"
 			    "\tbin/linesegm data/saintgall/images/csg562-003.jpg --stats\n");
 
 	    exit(0);
@@ -55,9 +108,9 @@ inline Mat distance_transform (Mat input) {
 	return dmat;
 }
 
+// Draws `path` two pixels wide into the 0/1 image `graph`.
 template<typename Node>
-inline void draw_path (Mat& graph, vector<Node>& path) {
-
+inline void mark_path (Mat& graph, const vector<Node>& path) {
 	for (auto node : path) {
 		int row, col;
 		tie (row, col) = node;
@@ -66,6 +119,11 @@ inline void draw_path (Mat& graph, vector<Node>& path) {
 			graph.at<uchar>(row, col + 1) = (uchar) 0;
 		}
 	}
+}
+
+template<typename Node>
+inline void draw_path (Mat& graph, vector<Node>& path) {
+	mark_path(graph, path);
 	imwrite("data/map.jpg", graph*255);
 }
 
@@ -172,8 +230,9 @@ inline void ensure_directory_exists(string dir_path) {
 			}	
 }
 
+// The text line between two boundaries, as a 0/1 image of the full width.
 template<typename Node>
-inline void segment_text_line (Mat& input, string out_dir, int line_id, vector<Node> lower, vector<Node> upper) {
+inline Mat text_line_image (Mat& input, vector<Node> lower, vector<Node> upper) {
 	Mat output = input.clone();
 
 	int highest_pos = highest_boundary_pos(upper);
@@ -182,12 +241,17 @@ inline void segment_text_line (Mat& input, string out_dir, int line_id, vector<N
 	segment_above_boundary(output, lower);
 	segment_below_boundary(output, upper);
 
-	output = extract_bounding_box(output, 0, highest_pos, input.cols, lowest_pos-highest_pos);
-	imwrite(out_dir + "line_" + to_string(line_id) + ".jpg", output*255);
+	return extract_bounding_box(output, 0, highest_pos, input.cols, lowest_pos-highest_pos);
 }
 
 template<typename Node>
-inline void segment_text_line (Mat& input, string out_dir, int line_id, bool boundary_is_lower, vector<Node> boundary) {
+inline void segment_text_line (Mat& input, string out_dir, int line_id, vector<Node> lower, vector<Node> upper) {
+	imwrite(out_dir + "line_" + to_string(line_id) + ".jpg", text_line_image(input, lower, upper)*255);
+}
+
+// The first (above `boundary`) or last (below it) text line of a region.
+template<typename Node>
+inline Mat text_line_image (Mat& input, bool boundary_is_lower, vector<Node> boundary) {
 	Mat output = input.clone();
 
 	if (boundary_is_lower) {
@@ -201,8 +265,12 @@ inline void segment_text_line (Mat& input, string out_dir, int line_id, bool bou
 		segment_below_boundary(output, boundary);
 		output = extract_bounding_box(output, 0, highest_pos, input.cols, lower_bound-highest_pos);
 	}
+	return output;
+}
 
-	imwrite(out_dir + "line_" + to_string(line_id) + ".jpg", output*255);
+template<typename Node>
+inline void segment_text_line (Mat& input, string out_dir, int line_id, bool boundary_is_lower, vector<Node> boundary) {
+	imwrite(out_dir + "line_" + to_string(line_id) + ".jpg", text_line_image(input, boundary_is_lower, boundary)*255);
 }
 
 template<typename Node>
@@ -281,104 +349,4 @@ inline int count_occurences (Mat& input, int num) {
 	return count;
 }
 
-inline vector<double> select_best_assignments (vector<double>& hitrate, vector<double>& line_detection_GT, vector<double>& line_detection_R,
-									 vector<string> lines, string groudtruth) {
-
-	auto max = max_element(hitrate.begin(), hitrate.end());
-	int pos = distance(hitrate.begin(), max);
-
-	double hit_rate = *max;
-	double line_det_GT = line_detection_GT[pos];
-	double line_det_R = line_detection_R[pos];
-
-	vector<double> stats;
-	stats.push_back(hit_rate);
-	stats.push_back(line_det_GT);
-	stats.push_back(line_det_R);
-
-	cout << "\t## Groundtruth: " << groudtruth << " - Detected: " << lines[pos];
-	cout << " - Hit rate: " << to_string(*max);
-	cout << " - Line detection GT: " << to_string(line_det_GT);
-	cout << " - Line detection R: " << to_string(line_det_R) << endl;
-
-	return stats;
-
-}
-
-inline void compute_statistics (string filename) {
-
-	string dataset = infer_dataset(filename);
-
-	string rem1 = "data/" + dataset + "/images/";
-	string rem2 = ".jpg";
-	string repl = "";
-	strreplace(filename, rem1, repl);
-	strreplace(filename, rem2, repl);
-
-	string folder_lines = "data/" + dataset + "/detected/" + filename + "/";
-	string folder_groundtruth = "data/" + dataset + "/groundtruth/" + filename + "/";
-
-	vector<string> lines = read_folder(folder_lines.c_str());
-	vector<string> groundtruth = read_folder(folder_groundtruth.c_str());
-
-	Mat line, ground, united, shared;
-
-	int tot_correctly_detected = 0;
-	double tot_hitrate, tot_line_detection_GT, tot_line_detection_R = 0;
-	for (unsigned int i = 0; i < groundtruth.size(); i++) {
-
-		vector<double> hitrate, line_detection_GT, line_detection_R;
-		ground =  imread(folder_groundtruth + groundtruth[i], 0) / 255;
-
-		for (unsigned int j = 0; j < lines.size(); j++){
-
-			line = imread(folder_lines + lines[j], 0) / 255;
-
-			bitwise_or(line, ground, shared);
-			bitwise_and(line, ground, united);
-
-			int black_pixels_line = countNonZero(line == 0);
-			int black_pixels_ground = countNonZero(ground == 0);
-			int black_pixels_shared = countNonZero(shared == 0);
-			int black_pixels_united = countNonZero(united == 0);
-
-			hitrate.push_back((((double) black_pixels_shared) / ((double) black_pixels_united)));
-			line_detection_GT.push_back((((double) black_pixels_shared) / ((double) black_pixels_ground)));
-			line_detection_R.push_back((((double) black_pixels_shared) / ((double) black_pixels_line)));
-		}
-
-		vector<double> stats = select_best_assignments(hitrate, line_detection_GT, line_detection_R, lines, groundtruth[i]);
-		tot_hitrate = tot_hitrate + stats[0];
-		tot_line_detection_GT = tot_line_detection_GT + stats[1];
-		tot_line_detection_R = tot_line_detection_R + stats[2];
-
-		if (stats[1] >= 0.9 && stats[2] >= 0.9) {
-			tot_correctly_detected++;
-		}
-
-	}
-
-	cout << "\n\t## Avg. stats ==> ";
-	cout << " Hit rate: " << to_string(tot_hitrate / groundtruth.size());
-	cout << " - Line detection GT: " << to_string(tot_line_detection_GT / groundtruth.size());
-	cout << " - Line detection R: " << to_string(tot_line_detection_R / groundtruth.size());
-	cout << " - Correctly detected: " << to_string(tot_correctly_detected) << "/" << to_string(groundtruth.size()) << endl;
-
-	ofstream csvfile;
-	csvfile.open("data/" + dataset + "/stats.csv", std::ios_base::app);
-	csvfile << filename;
-	csvfile << ",";
-	csvfile << int(round((tot_hitrate / groundtruth.size()) * 100));
-	csvfile << ",";
-	csvfile << int(round((tot_line_detection_GT / groundtruth.size()) * 100));
-	csvfile << ",";
-	csvfile << int(round((tot_line_detection_R / groundtruth.size()) * 100));
-	csvfile << ",";
-	csvfile << tot_correctly_detected;
-	csvfile << ",";
-	csvfile << groundtruth.size();
-	csvfile << "\n";
-
-	csvfile.close();
-
-}
+#endif
@@ -0,0 +1,210 @@
+/*
+ * wavefront.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef WAVEFRONT_CPP
+#define WAVEFRONT_CPP
+
+#include "opencv2/opencv.hpp"
+#include "astar.cpp"
+#include "workerpool.cpp"
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+
+/*
+ * Column by column dynamic programming solver for separators that run left
+ * to right. The path moves `step` columns east at a time, going north-east,
+ * east or south-east by `step` rows, with the same cost as the A* search
+ * (compute_cost over the shared cost field). Being monotone in the column,
+ * it cannot detour around ink vertically like A* can. What it gets in exchange is a
+ * fixed amount of work per page and no priority queue. A move that enters a
+ * pixel of Map::blocked is never taken, as in the A* search, and with a
+ * step above 1 every ink pixel (Map::walls) a move passes over on its way
+ * to the next column costs the ink weight, so that the pixels the path is
+ * replayed through below are paid for.
+ *
+ * The rows of a column are split into bands, one per thread. A band can
+ * compute column j once both neighbouring bands have finished column j - 1,
+ * so the threads move forward as a wavefront without a global barrier. Two
+ * columns of g-scores are kept in rolling buffers; the per-cell choices are
+ * kept to reconstruct the path. Every cell is computed from the same
+ * inputs in the same order whatever the number of threads, so the result
+ * is deterministic. Ties prefer east, then north-east, then south-east.
+ * The band threads come from `pool` if it has enough of them. The inner
+ * loop is a branch-free minimum, which the compiler only vectorizes in an
+ * optimized build (OPT="-O3" ./makefile.sh); the default -O0 build runs it
+ * one cell at a time.
+ *
+ * The path is written into `state` as unit moves, so reconstruct_path works
+ * as after astar_search. The search is limited to the state window.
+ * Returns the number of cells evaluated.
+ */
+template<typename Graph>
+inline size_t wavefront_search (const Graph& graph, typename Graph::Node start, typename Graph::Node goal,
+					SearchState& state, const CostWeights& weights, int step, int threads, WorkerPool* pool = nullptr) {
+
+	typedef typename Graph::Node Node;
+	const float INF = numeric_limits<float>::infinity();
+	const int NE = 2, E = 4, SE = 7;
+
+	int srow, scol, grow, gcol;
+	tie (srow, scol) = start;
+	tie (grow, gcol) = goal;
+	state.reset();
+	if (gcol < scol or !state.contains(srow, scol) or !state.contains(grow, gcol)) {
+		return 0;
+	}
+
+	// Rows reachable from the start: every step-th row of the window.
+	int top = state.window.y, bottom = min(state.window.y + state.window.height, graph.walls.rows);
+	int first = srow - ((srow - top) / step) * step;
+	int K = (bottom - 1 - first) / step + 1;
+	int J = (gcol - scol) / step + 1;
+	int k_start = (srow - first) / step;
+	int k_goal = (grow - first) % step == 0 ? (grow - first) / step : -1;
+	if (k_goal < 0 or k_goal >= K) {
+		return 0;
+	}
+
+	vector<float> vertical(K);
+	for (int k = 0; k < K; k++) {
+		vertical[k] = (float) (weights.vertical * abs(first + k*step - srow));
+	}
+
+	float straight = (float) (weights.neighbor * 10), diagonal = (float) (weights.neighbor * 14);
+
+	// Extra cost of the move of `step` pixels from (row, col) in direction (dr, 1): infinite if blocked, else the ink it passes over.
+	bool guarded = step > 1 or !graph.blocked.empty();
+	float ink = (float) weights.ink;
+	auto move_extra = [&] (int row, int col, int dr) {
+		if (graph.move_blocked(row, col, dr, 1, step)) {
+			return INF;
+		}
+		float extra = 0;
+		for (int s = 1; s < step; s++) {
+			if (graph.walls.test(row + s*dr, col + s)) {
+				extra += ink;
+			}
+		}
+		return extra;
+	};
+
+	// g-scores padded with an infinite row on both sides.
+	vector<float> g[2] = {vector<float>(K + 2, INF), vector<float>(K + 2, INF)};
+	g[0][k_start + 1] = 0;
+	TrackedVector<uchar> choice((size_t) J * K, E);
+
+	int bands = max(1, min(threads, K / 64));
+	unique_ptr<atomic<int>[]> progress(new atomic<int>[bands]);
+	for (int b = 0; b < bands; b++) {
+		progress[b] = 1;
+	}
+
+	auto work = [&] (int b) {
+		int k0 = (int) ((long) K * b / bands), k1 = (int) ((long) K * (b + 1) / bands);
+		vector<float> column(k1 - k0);
+		vector<float> ne_extra(guarded ? k1 - k0 : 0), e_extra(guarded ? k1 - k0 : 0), se_extra(guarded ? k1 - k0 : 0);
+
+		for (int j = 1; j < J; j++) {
+			for (int n = b - 1; n <= b + 1; n += 2) {
+				if (n < 0 or n >= bands) {
+					continue;
+				}
+				while (progress[n].load(memory_order_acquire) < j) {
+					this_thread::yield();
+				}
+			}
+
+			int col = scol + j*step;
+			for (int k = k0; k < k1; k++) {
+				column[k - k0] = graph.costs.at(first + k*step, col) + vertical[k];
+			}
+
+			const float* prev = g[(j - 1) & 1].data() + 1;
+			float* next = g[j & 1].data() + 1;
+			uchar* chosen = choice.data() + (size_t) j * K;
+			if (guarded) {
+				for (int k = k0; k < k1; k++) {
+					int row = first + k*step;
+					e_extra[k - k0] = move_extra(row, col - step, 0);
+					ne_extra[k - k0] = k + 1 < K ? move_extra(row + step, col - step, -1) : INF;
+					se_extra[k - k0] = k > 0 ? move_extra(row - step, col - step, 1) : INF;
+				}
+				for (int k = k0; k < k1; k++) {
+					float e = prev[k] + straight + e_extra[k - k0];
+					float ne = prev[k + 1] + diagonal + ne_extra[k - k0];
+					float se = prev[k - 1] + diagonal + se_extra[k - k0];
+					float best = min(e, min(ne, se));
+					chosen[k] = best == e ? E : (best == ne ? NE : SE);
+					next[k] = best + column[k - k0];
+				}
+			} else {
+				for (int k = k0; k < k1; k++) {
+					float e = prev[k] + straight, ne = prev[k + 1] + diagonal, se = prev[k - 1] + diagonal;
+					float best = min(e, min(ne, se));
+					chosen[k] = best == e ? E : (best == ne ? NE : SE);
+					next[k] = best + column[k - k0];
+				}
+			}
+
+			progress[b].store(j + 1, memory_order_release);
+		}
+	};
+
+	if (bands == 1) {
+		work(0);
+	} else {
+		unique_ptr<WorkerPool> own;
+		if (!pool or pool->size() < bands) {
+			own.reset(new WorkerPool(bands));
+			pool = own.get();
+		}
+		pool->run(bands, work);
+	}
+
+	// No path if the blocked pixels cut the start off from the goal.
+	if (g[(J - 1) & 1][k_goal + 1] == INF) {
+		return (size_t) J * K;
+	}
+
+	// Walk the choices back from the last column and replay them forwards as unit moves.
+	vector<uchar> moves(J);
+	for (int j = J - 1, k = k_goal; j >= 1; j--) {
+		moves[j] = choice[(size_t) j * K + k];
+		k -= get<0>(graph.directions[moves[j]]);
+	}
+
+	int row = srow, col = scol, dr, dc;
+	float gpath = 0;
+	state.reach(state.index(row, col), 0, 0, 0);
+	for (int j = 1; j < J; j++) {
+		tie (dr, dc) = graph.directions[moves[j]];
+		for (int s = 0; s < step; s++) {
+			Node current(row, col);
+			row += dr;
+			col += dc;
+			gpath += (float) compute_cost(graph, current, Node(row, col), start, weights);
+			state.reach(state.index(row, col), gpath, moves[j], 0);
+		}
+	}
+
+	// The goal column is not always a whole number of steps away.
+	while (col < gcol) {
+		Node current(row, col);
+		col++;
+		gpath += (float) compute_cost(graph, current, Node(row, col), start, weights);
+		state.reach(state.index(row, col), gpath, E, 0);
+	}
+
+	return (size_t) J * K;
+}
+
+#endif
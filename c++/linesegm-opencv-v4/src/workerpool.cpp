@@ -0,0 +1,97 @@
+/*
+ * workerpool.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef WORKERPOOL_CPP
+#define WORKERPOOL_CPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+
+/*
+ * Threads kept for the line searches of a region, instead of new ones for
+ * every line: run() hands a job to the first n workers and returns once all
+ * of them are done with it. Between jobs the workers wait on a condition
+ * variable.
+ */
+class WorkerPool {
+
+	mutex lock;
+	condition_variable wake;
+	condition_variable finished;
+	vector<thread> workers;
+	function<void (int)> job;
+	int parties;     // workers taking part in the current job
+	int running;     // of those, the ones not done yet
+	long generation; // bumped for every job
+	bool stopping;
+
+	inline void work (int id) {
+		long seen = 0;
+		unique_lock<mutex> guard(lock);
+		while (true) {
+			wake.wait(guard, [&] () { return stopping or generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+			if (id >= parties) {
+				continue;
+			}
+			guard.unlock();
+			job(id);
+			guard.lock();
+			if (--running == 0) {
+				finished.notify_all();
+			}
+		}
+	}
+
+public:
+
+	explicit WorkerPool (int size) : parties(0), running(0), generation(0), stopping(false) {
+		for (int t = 0; t < size; t++) {
+			workers.push_back(thread(&WorkerPool::work, this, t));
+		}
+	}
+
+	WorkerPool (const WorkerPool&) = delete;
+	WorkerPool& operator= (const WorkerPool&) = delete;
+
+	~WorkerPool () {
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	inline int size () const {
+		return (int) workers.size();
+	}
+
+	// Runs f(0) .. f(n - 1) on as many workers, n at most size(), and waits for all of them.
+	inline void run (int n, function<void (int)> f) {
+		unique_lock<mutex> guard(lock);
+		job = f;
+		parties = running = n;
+		generation++;
+		wake.notify_all();
+		finished.wait(guard, [this] () { return running == 0; });
+		job = nullptr;
+	}
+
+};
+
+#endif